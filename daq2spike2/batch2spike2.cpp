@@ -0,0 +1,575 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+/* Convert every edt, bdt and daq recording in a directory, or listed in a
+   manifest file, to .smr files. Each conversion is a run of edt2spike2 or
+   daq2spike2 in its own process, a small pool of worker threads keeps a
+   bounded number of them going at once. The pool is sized to the number of
+   cores, and no more than a few conversions read from the same disk at the
+   same time since these are mostly I/O bound.
+
+   <output>.src holds the crc32 of the inputs, it is removed before a
+   conversion and written again only when it works, so an output without
+   one is from a run that failed or was killed and is always redone. One
+   with it is up to date and skipped if it is newer than its inputs. If
+   the input is newer, perhaps only touched or copied, the crc32 of the
+   inputs is compared against the saved one, and the file is skipped if
+   they match.
+
+   Mod History
+   Sun Oct 18 2026 Created.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <spawn.h>
+#include <getopt.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "gzstream.h"
+
+using namespace std;
+
+const int DEF_PER_DISK = 2;             // conversions reading one disk at once
+const size_t LOG_SCAN_SIZ = 0x10000;    // look this far into a log for the timestamp
+const size_t HASH_BUFF_SIZ = 0x100000;
+const string DAQ_TAG("_1-64.daq");
+const string DAQ_TAG2("_65-128.daq");
+const string STAMP_TAG("Recording started at ");
+const string LOG_TAG("_batch.log");     // after <name>_<kind> for each conversion's output
+
+enum JOB_STATE {PENDING, RUNNING, CONVERTED, UP_TO_DATE, SAME_HASH, FAILED, NO_STAMP};
+const char* StateNames[] = {"pending", "running", "converted", "up to date",
+                            "same crc", "FAILED", "NO TIMESTAMP"};
+
+class Job
+{
+   public:
+      string kind;           // edt, bdt or daq
+      string input;          // file name, for daq the _1-64 file
+      vector<string> inputs; // every file the conversion reads
+      string base;           // name without extension/daq tag
+      string output;
+      string stamp;          // daq recording date/time
+      dev_t dev = 0;
+      off_t bytes = 0;
+      double secs = 0;
+      JOB_STATE state = PENDING;
+      int status = 0;
+};
+
+// globals
+string DirName;
+string ManifestName;
+string ExeDir;
+string Irregular("resample");
+int NumJobs = 0;
+int PerDisk = DEF_PER_DISK;
+bool Force = false;
+vector<Job> Jobs;
+mutex JobLock;
+condition_variable JobReady;
+map<dev_t,int> DiskBusy;
+
+
+static void usage(char *name)
+{
+   cout << "Program to convert a directory of .edt, .bdt and .daq recordings "
+        << "to Spike2 .smr files." << endl << "Version " << VERSION << endl
+        << endl << "Usage: " << name
+        << " -d directory | -m manifest_file [-j jobs] [-p per_disk] [-f]"
+        << " [-irregular=resample|realmark|abort]" << endl << endl
+        << "   -d    convert every *.edt, *.bdt and *_1-64.daq file in directory" << endl
+        << "         (.gz versions too). The daq timestamp is found in a log file" << endl
+        << "         starting with the recording name that has a line such as" << endl
+        << "         Recording started at 2014-06-24 21:31:53:515" << endl
+        << "   -m    convert the files listed in manifest_file, one per line." << endl
+        << "         A daq line can give the timestamp after a comma:" << endl
+        << "         /data/2014-06-24_001_1-64.daq,2014-06-24 21:31:53:515" << endl
+        << "   -j    number of conversions at once, default is the number of cores" << endl
+        << "   -p    most conversions reading from one disk at once, default "
+        << DEF_PER_DISK << endl
+        << "   -f    convert even if the output is up to date" << endl
+        << "   -irregular   passed to edt2spike2, default is resample" << endl << endl
+        << "The output of each conversion is saved in <name>_<edt|bdt|daq>_batch.log." << endl;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+   int ret = 1;
+   int cmd;
+   static struct option opts[] =
+   {
+      {"d", required_argument, NULL, 'd'},
+      {"m", required_argument, NULL, 'm'},
+      {"j", required_argument, NULL, 'j'},
+      {"p", required_argument, NULL, 'p'},
+      {"f", no_argument, NULL, 'f'},
+      {"irregular", required_argument, NULL, 'i'},
+      {"h", no_argument, NULL, 'h'},
+      { 0,0,0,0}
+   };
+   while ((cmd = getopt_long_only(argc, argv, "", opts, NULL )) != -1)
+   {
+      switch (cmd)
+      {
+         case 'd':
+               DirName = optarg;
+               break;
+         case 'm':
+               ManifestName = optarg;
+               break;
+         case 'j':
+               NumJobs = atoi(optarg);
+               break;
+         case 'p':
+               PerDisk = max(1, atoi(optarg));
+               break;
+         case 'f':
+               Force = true;
+               break;
+         case 'i':
+               Irregular = optarg;
+               break;
+         case 'h':
+         case '?':
+         default:
+            ret = 0;
+           break;
+      }
+   }
+   if (ret && DirName.empty() == ManifestName.empty())
+   {
+      cout << "Give either a directory or a manifest file." << endl;
+      ret = 0;
+   }
+   if (!ret)
+   {
+      usage(argv[0]);
+      cout << "Exiting. . ." << endl;
+      exit(1);
+   }
+}
+
+
+static bool ends_with(const string& str, const string& tail)
+{
+   return str.size() >= tail.size() && str.compare(str.size() - tail.size(), tail.size(), tail) == 0;
+}
+
+// True for the _spk, _anN and _shardN files edt_split makes
+static bool split_output(const string& plain)
+{
+   size_t dot = plain.find_last_of('.');
+   string stem = plain.substr(0, dot);
+   if (ends_with(stem, "_spk"))
+      return true;
+   for (const string& tag : {string("_an"), string("_shard")})
+   {
+      size_t at = stem.rfind(tag);
+      if (at != string::npos && at + tag.size() < stem.size() &&
+          stem.find_first_not_of("0123456789", at + tag.size()) == string::npos)
+         return true;
+   }
+   return false;
+}
+
+static string dir_of(const string& path)
+{
+   size_t slash = path.find_last_of('/');
+   return slash == string::npos ? string(".") : path.substr(0, slash);
+}
+
+
+/* Look through the log files next to a daq recording for the line
+   Recording started at 2014-06-24 21:31:53:515
+   and return the date/time part, or an empty string.
+*/
+static string find_stamp(const string& base)
+{
+   string dir = dir_of(base);
+   string name = base.substr(base.find_last_of('/') + 1);
+   DIR* dp = opendir(dir.c_str());
+   struct dirent* ent;
+   string stamp;
+
+   if (!dp)
+      return stamp;
+   while (stamp.empty() && (ent = readdir(dp)) != nullptr)
+   {
+      string fname = ent->d_name;
+      if (fname.compare(0, name.size(), name) != 0 || ends_with(fname, ".daq") ||
+          ends_with(fname, ".gz") || ends_with(fname, ".smr") || ends_with(fname, LOG_TAG))
+         continue;
+      ifstream log((dir + "/" + fname).c_str(), ios::binary);
+      string text(LOG_SCAN_SIZ, '\0');
+      log.read(&text[0], text.size());
+      text.resize(log.gcount());
+      size_t pos = text.find(STAMP_TAG);
+      if (pos != string::npos)
+      {
+         pos += STAMP_TAG.size();
+         size_t eol = text.find_first_of("\r\n", pos);
+         stamp = text.substr(pos, eol == string::npos ? string::npos : eol - pos);
+      }
+   }
+   closedir(dp);
+   return stamp;
+}
+
+
+/* Make a job for a file if it is something we convert. The stamp is only
+   used for daq files, if it is empty look for a log file.
+*/
+static void add_job(const string& path, const string& stamp)
+{
+   Job job;
+   struct stat stats;
+   string plain = gz_strip(path);
+
+   if (ends_with(plain, DAQ_TAG))
+   {
+      job.kind = "daq";
+      job.base = plain.substr(0, plain.size() - DAQ_TAG.size());
+      job.output = job.base + "_from_daq.smr";
+      job.stamp = stamp.size() ? stamp : find_stamp(job.base);
+      job.inputs.push_back(path);
+      string second = gz_name(job.base + DAQ_TAG2);
+      if (stat(second.c_str(), &stats) == 0)
+         job.inputs.push_back(second);
+      if (job.stamp.empty())
+         job.state = NO_STAMP;
+   }
+   else if (ends_with(plain, ".edt") || ends_with(plain, ".bdt"))
+   {
+      job.kind = plain.substr(plain.size() - 3);
+      job.base = plain.substr(0, plain.size() - 4);
+      job.output = job.base + "_from_" + job.kind + ".smr";
+      job.inputs.push_back(path);
+   }
+   else
+      return;
+
+   job.input = path;
+   for (auto& name : job.inputs)
+   {
+      if (stat(name.c_str(), &stats) != 0)
+      {
+         cout << "Could not find " << name << ", skipping it." << endl;
+         return;
+      }
+      job.bytes += stats.st_size;
+      job.dev = stats.st_dev;
+   }
+   Jobs.push_back(job);
+}
+
+static void scan_dir()
+{
+   DIR* dp = opendir(DirName.c_str());
+   struct dirent* ent;
+   vector<string> names;
+
+   if (!dp)
+   {
+      cout << "Could not open directory " << DirName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   while ((ent = readdir(dp)) != nullptr)
+      names.push_back(ent->d_name);
+   closedir(dp);
+   sort(names.begin(), names.end());
+   for (auto& name : names)
+   {
+      string plain = gz_strip(name);
+        // edt_split outputs are not recordings
+      if (split_output(plain))
+         continue;
+        // if we have both x.edt and x.edt.gz, use the plain one
+      if (plain != name && binary_search(names.begin(), names.end(), plain))
+         continue;
+      add_job(DirName + "/" + name, "");
+   }
+}
+
+static void read_manifest()
+{
+   ifstream manifest(ManifestName.c_str());
+   string line;
+
+   if (!manifest.is_open())
+   {
+      cout << "Could not open " << ManifestName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   while (getline(manifest, line))
+   {
+      if (line.size() && line.back() == '\r')
+         line.pop_back();
+      if (line.empty() || line[0] == '#')
+         continue;
+      size_t comma = line.find(',');
+      string path = line.substr(0, comma);
+      string stamp = comma == string::npos ? "" : line.substr(comma + 1);
+      size_t before = Jobs.size();
+      add_job(path, stamp);
+      if (Jobs.size() == before)
+         cout << path << " is not an edt, bdt or _1-64.daq file, skipping it." << endl;
+   }
+}
+
+
+// crc32 of all of the inputs, as text
+static string input_crc(const Job& job)
+{
+   vector<char> buff(HASH_BUFF_SIZ);
+   stringstream strm;
+
+   for (auto& name : job.inputs)
+   {
+      uLong crc = crc32(0L, Z_NULL, 0);
+      ifstream in(name.c_str(), ios::binary);
+      while (in.read(buff.data(), buff.size()) || in.gcount())
+         crc = crc32(crc, reinterpret_cast<Bytef*>(buff.data()), in.gcount());
+      strm << hex << crc << " ";
+   }
+   return strm.str();
+}
+
+// edt2spike2 makes a .smrx file instead of a .smr one for very long recordings
+static void find_output(Job& job)
+{
+   struct stat stats;
+   if (stat(job.output.c_str(), &stats) != 0 && stat((job.output + "x").c_str(), &stats) == 0)
+      job.output += "x";
+}
+
+static bool up_to_date(Job& job)
+{
+   struct stat out, in;
+
+   find_output(job);
+   if (Force || stat(job.output.c_str(), &out) != 0)
+      return false;
+   ifstream src((job.output + ".src").c_str());
+   string saved;
+   if (!getline(src, saved))   // a partial output from a run that did not finish
+      return false;
+   bool newer = true;
+   for (auto& name : job.inputs)
+      if (stat(name.c_str(), &in) != 0 || in.st_mtime > out.st_mtime)
+         newer = false;
+   if (newer)
+   {
+      job.state = UP_TO_DATE;
+      return true;
+   }
+   if (saved == input_crc(job))
+   {
+      job.state = SAME_HASH;
+      return true;
+   }
+   return false;
+}
+
+
+/* Run one conversion in a child process, output goes to the job's log file.
+   Return the exit status.
+*/
+static int run_job(const Job& job)
+{
+   vector<string> args;
+   string prog = ExeDir + (job.kind == "daq" ? "daq2spike2" : "edt2spike2");
+   string log = job.base + "_" + job.kind + LOG_TAG;   // x.edt and x.bdt can run at once
+   posix_spawn_file_actions_t actions;
+   pid_t pid;
+   int status = -1;
+
+   args.push_back(prog);
+   if (job.kind == "daq")
+   {
+      args.push_back("-n");
+      args.push_back(job.base);
+      args.push_back("-t");
+      args.push_back(job.stamp);
+   }
+   else
+   {
+      args.push_back("-n");
+      args.push_back(job.input);
+      args.push_back("-irregular=" + Irregular);
+   }
+   vector<char*> argv;
+   for (auto& arg : args)
+      argv.push_back(const_cast<char*>(arg.c_str()));
+   argv.push_back(nullptr);
+
+   posix_spawn_file_actions_init(&actions);
+   posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+   posix_spawn_file_actions_addopen(&actions, 1, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0664);
+   posix_spawn_file_actions_adddup2(&actions, 1, 2);
+   if (posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0)
+   {
+      if (waitpid(pid, &status, 0) != pid)
+         status = -1;
+   }
+   else
+      cout << "Could not run " << prog << ": " << strerror(errno) << endl;
+   posix_spawn_file_actions_destroy(&actions);
+   return status;
+}
+
+
+/* Worker thread. Take the next pending job whose disk is not already busy
+   with PerDisk conversions, run it and save the crc of its inputs.
+*/
+static void worker()
+{
+   while (true)
+   {
+      size_t idx;
+      {
+         unique_lock<mutex> guard(JobLock);
+         auto next = [&] {
+            for (idx = 0; idx < Jobs.size(); ++idx)
+               if (Jobs[idx].state == PENDING && DiskBusy[Jobs[idx].dev] < PerDisk)
+                  return true;
+            return false;
+         };
+         auto left = [&] {
+            return any_of(Jobs.begin(), Jobs.end(), [](const Job& job){return job.state == PENDING;});
+         };
+         JobReady.wait(guard, [&]{return next() || !left();});
+         if (!left())
+            return;
+         Jobs[idx].state = RUNNING;
+         ++DiskBusy[Jobs[idx].dev];
+         cout << "Converting " << Jobs[idx].input << endl;
+      }
+      Job& job = Jobs[idx];
+      unlink((job.output + ".src").c_str());
+      auto start = chrono::steady_clock::now();
+      job.status = run_job(job);
+      job.secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      bool ok = WIFEXITED(job.status) && WEXITSTATUS(job.status) == 0;
+      if (ok)
+      {
+         find_output(job);
+         ofstream src((job.output + ".src").c_str());
+         src << input_crc(job) << endl;
+      }
+      {
+         lock_guard<mutex> guard(JobLock);
+         job.state = ok ? CONVERTED : FAILED;
+         --DiskBusy[job.dev];
+         cout << (ok ? "Finished " : "FAILED ") << job.input << endl;
+      }
+      JobReady.notify_all();
+   }
+}
+
+
+static void summary()
+{
+   double total_mb = 0, total_secs = 0;
+   int failed = 0;
+
+   printf("\n%-50s %10s %9s %8s  %s\n", "Input", "MB", "Seconds", "MB/s", "Status");
+   for (auto& job : Jobs)
+   {
+      string name = job.input.substr(job.input.find_last_of('/') + 1);
+      double mb = job.bytes / 1048576.0;
+      if (job.state == CONVERTED)
+      {
+         printf("%-50s %10.1f %9.1f %8.1f  %s\n", name.c_str(), mb, job.secs,
+                job.secs > 0 ? mb / job.secs : 0.0, StateNames[job.state]);
+         total_mb += mb;
+         total_secs += job.secs;
+      }
+      else
+         printf("%-50s %10.1f %9s %8s  %s\n", name.c_str(), mb, "-", "-", StateNames[job.state]);
+      if (job.state == FAILED || job.state == NO_STAMP)
+         ++failed;
+   }
+   printf("Converted %.1f MB in %.1f process seconds", total_mb, total_secs);
+   if (total_secs > 0)
+      printf(", %.1f MB/s per conversion", total_mb / total_secs);
+   printf("\n");
+   if (failed)
+      printf("%d recording(s) were not converted, see the <name>_<edt|bdt|daq>_batch.log files.\n", failed);
+}
+
+
+int main(int argc, char *argv[])
+{
+   cout << "Program to convert a directory of recordings to Spike2 .smr files." << endl
+        << "Version " << VERSION << endl;
+   parse_args(argc, argv);
+
+     // use the converters next to us, if we were run with a path
+   string self = argv[0];
+   if (self.find('/') != string::npos)
+      ExeDir = dir_of(self) + "/";
+
+   if (DirName.size())
+      scan_dir();
+   else
+      read_manifest();
+   if (Jobs.empty())
+   {
+      cout << "Nothing to convert." << endl;
+      exit(0);
+   }
+   for (auto& job : Jobs)
+      if (job.state == PENDING)
+         up_to_date(job);
+
+   if (NumJobs <= 0)
+      NumJobs = max(1u, thread::hardware_concurrency());
+   NumJobs = min((size_t) NumJobs, Jobs.size());
+   cout << "Found " << Jobs.size() << " recordings, running up to " << NumJobs
+        << " conversions at once, " << PerDisk << " per disk." << endl;
+   vector<thread> pool;
+   for (int num = 0; num < NumJobs; ++num)
+      pool.emplace_back(worker);
+   for (auto& thr : pool)
+      thr.join();
+   summary();
+   exit(any_of(Jobs.begin(), Jobs.end(), [](const Job& job)
+               {return job.state == FAILED || job.state == NO_STAMP;}));
+}
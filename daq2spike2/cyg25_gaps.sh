@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Copyright 2005-2020 Kendall F. Morris
+#
+# This file is part of a collection of recording processing software,
+# distributed under the GNU General Public License, version 3 or later.
+# See COPYING.
+#
+# Checks that cyg2cyg25KHz only fills real dropouts and only moves pulses
+# that are well off. Synthetic tapes with timing pulses a little off,
+# which must be upsampled as they are, ones far off, which are moved or
+# filled, and irregular intervals as short as half an interval or
+# longer than one, which must still come out DAQ_INTV samples each. make
+# check runs it.
+#
+# Usage: cyg25_gaps.sh [dir with cyg2cyg25KHz and cyg_synth]
+#
+# Mod History
+# Sun Oct 18 2026 Created.
+#                 Count every repair but irregular, and check the output
+#                 length.
+
+BIN=$(cd "${1:-.}" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+FAILED=0
+
+# name, pulse intervals, marker blocks, repairs other than irregular, and
+# 25 KHz intervals out for the 30 pulses
+check()
+{
+   IFS=, read -ra list <<< "$2"
+   span=0
+   for ((pulse = 0; pulse < 29; ++pulse))
+   do
+      span=$((span + list[pulse % ${#list[@]}]))
+   done
+   for resamp in linear sinc
+   do
+      "$BIN/cyg_synth" -o $1.cyg -intervals $2 -tones 1000,5000 > /dev/null || exit 1
+      "$BIN/cyg2cyg25KHz" -a $1.cyg,16 -resampler=$resamp > $1.out || exit 1
+      markers=$("$BIN/cyg_synth" -markers $1_25KHz.dd)
+      fixed=$(tail -n +2 $1_25KHz.repairs.tsv | cut -f2 | grep -vc irregular)
+        # peak to peak is 5000 blocks of 32 bytes an interval, the rest as is
+      want=$(( $(stat -c %s $1.cyg) + ($5 * 5000 - span) * 32 ))
+      size=$(stat -c %s $1_25KHz.dd)
+      if [ "$markers" != "$3" ] || [ "$fixed" != "$4" ] || [ "$size" != "$want" ] || grep -q What $1.out
+      then
+         echo "FAILED $1 $resamp: $markers marker blocks, $fixed repairs, $size bytes, expected $3, $4 and $want"
+         cat $1_25KHz.repairs.tsv
+         FAILED=1
+      else
+         echo "ok $1 $resamp"
+      fi
+      rm -f $1.cyg* $1.out
+   done
+}
+
+check late_jitter 4800,4800,4800,4815,4815,4800 0 0 29
+check early_jitter 4800,4800,4785,4785,4800,4800 0 0 29
+check both_jitter 4800,4800,4785,4815,4800,4800 0 0 29
+check late_pulse 4800,4800,4900,4700,4800,4800 0 10 29
+check short_irregular 4800,4800,2450,2450,4800,4800 0 0 29
+check long_irregular 4800,4800,6500,4800,4800,4800 0 0 29
+check dropout 4800,4800,4800,4800,11000,4800 50000 5 34
+exit $FAILED
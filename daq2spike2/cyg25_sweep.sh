@@ -0,0 +1,49 @@
+#!/bin/bash
+#
+# Copyright 2005-2020 Kendall F. Morris
+#
+# This file is part of a collection of recording processing software,
+# distributed under the GNU General Public License, version 3 or later.
+# See COPYING.
+#
+# Accuracy and speed of the cyg2cyg25KHz resamplers, run after changing
+# the SINC_* constants. Makes synthetic tapes with cyg_synth and prints,
+# for each tone, the gain and residual for linear and sinc, then the time
+# each takes with one thread on a 320 MB tape.
+#
+# Usage: cyg25_sweep.sh [dir with cyg2cyg25KHz and cyg_synth]
+#
+# Mod History
+# Sun Oct 18 2026 Created.
+
+BIN=$(cd "${1:-.}" && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+LOW=250,500,1000,1500,2000,2500,3000,3500,4000,4500,5000,5500,6000,6500,7000
+HIGH=7500,8000,8500,9000,9500,10000,10250,10500,10750,11000,11250,11500,11700,11800,11900
+
+for resamp in linear sinc
+do
+   for tones in $LOW $HIGH
+   do
+      "$BIN/cyg_synth" -o tones.cyg -tones $tones > /dev/null || exit 1
+      "$BIN/cyg2cyg25KHz" -a tones.cyg,16 -resampler=$resamp > /dev/null || exit 1
+      "$BIN/cyg_synth" -measure tones_25KHz.dd -tones $tones | tail -n +2
+   done > $resamp.txt
+done
+echo "                  linear                 sinc"
+printf "%9s %10s %12s %10s %12s\n" Hz "gain dB" "residual dB" "gain dB" "residual dB"
+join -j 1 linear.txt sinc.txt | awk '{printf "%9s %10s %12s %10s %12s\n", $1, $2, $3, $4, $5}'
+
+"$BIN/cyg_synth" -o long.cyg -pulses 2100 -tones $LOW > /dev/null || exit 1
+echo
+echo "Seconds for a $(( $(stat -c %s long.cyg) / 1000000 )) MB tape, one thread:"
+TIMEFORMAT=%R
+for resamp in linear sinc
+do
+   cat long.cyg > /dev/null
+   echo -n "$resamp "
+   { time "$BIN/cyg2cyg25KHz" -a long.cyg,16 -j 1 -resampler=$resamp > /dev/null ; } 2>&1
+done
@@ -37,6 +37,40 @@ This file is part of a collection of recording processing software.
 
    The algorithm used here was prototypes in the octave program upscale.m.
    Write a new .dd file out with _25KHz_ as part of the file name.
+
+   Dropouts are filled with -32768 on every chan, but that is also a full
+   scale negative sample, and cyg2daq turns it into daq value 1 like any
+   other. The only sure record of which output blocks were filled is
+   <output>.repairs.tsv, keep it with the .dd file.
+
+   Mod History
+   Sun Oct 18 2026 The timing pulses are found in one pass before upsampling,
+                   with the cyg_pulse scanner shared with cyg2daq.
+                   They are saved in a <tape>.pulses index, later runs on
+                   the same tape use it instead of scanning again.
+                   The lead-in and the tail are block copied with
+                   copy_file_range instead of a byte at a time.
+                   The time axes are walked without building them as
+                   vectors, the weights are the same to the last bit.
+                   Sample blocks are read as shorts and interpolated 16
+                   chans at a time with AVX2 when the cpu has it.
+                   The tape is read once through a TapeReader, an interval
+                   at a time, instead of seeking back to each peak.
+                   -j upsamples the intervals of a tape on several threads.
+                   The tapes are upsampled at the same time, one thread
+                   each, and progress for all of them is shown from main.
+                   -resampler=sinc upsamples with a windowed sinc filter
+                   bank instead of between neighboring samples.
+                   Intervals that are too short or long are sorted into
+                   spurious, missing, early or late pulses and dropouts,
+                   fixed up, and logged in <output>.repairs.tsv. Only an
+                   interval 1.5 intervals or more long is a dropout, one
+                   that is just off is upsampled as before. The repairs
+                   file is the only record of filled blocks.
+                   An early or late pulse is only moved when it is more
+                   than PULSE_MOVE off. An irregular interval of any
+                   length makes all DAQ_INTV samples, and zero sample
+                   steps are not reported.
 */
 
 #define _FILE_OFFSET_BITS 64
@@ -66,6 +100,20 @@ This file is part of a collection of recording processing software.
 #include <array>
 #include <vector>
 #include <algorithm> 
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+#include "cyg_tape.h"
+#include "cyg_pulse.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
 
 using namespace std;
 
@@ -86,6 +134,17 @@ const double TP_INTV = 1000.0/TP_RATE;     // pulse interval in ms
 const int IDEAL_CYG = CYG_RATE / TP_RATE;  // Exactly this many samples / interval
 const int INTV_BYTES = IDEAL_CYG*CYG_CHAN_BLOCK;
 const string TAPES("ABCD");
+const size_t COPY_BUFF_SIZ = 1 << 20;      // bytes per read when copy_file_range can't be used
+   // make sweep prints the accuracy and speed these give
+const int SINC_HALF = 16;                  // sinc taps each side of a 25 KHz sample
+const int SINC_TAPS = 2 * SINC_HALF;
+const int SINC_PHASES = 4096;              // filters in the bank, one per 1/4096 sample
+const double SINC_CUTOFF = 0.90;           // of the 12 KHz Nyquist
+const double SINC_BETA = 8.0;              // Kaiser window
+const int PULSE_SLACK = 10;                // samples an interval can be off IDEAL_CYG, kind of arbitrary
+const int PULSE_MOVE = 3 * PULSE_SLACK;    // an early or late pulse further off than this is moved
+const short GAP_MARKER = -32768;           // every chan of a dropout's output, can also be real data
+const string REPAIR_EXT(".repairs.tsv");
 
 #pragma pack(push,1) 
 using cygheader = struct 
@@ -108,9 +167,11 @@ class OneFile
    public:
       string InName = "";
       string OutName = "";
-      ifstream InStrm;
+      TapeReader Tape;
       ofstream OutStrm;
       int SyncChan = 0;
+      PulseIndex Pulses;    // every timing pulse in the file
+      size_t NextPulse = 0; // the one next_pulse hands out next
 };
 enum FILE_SLOT {A,B,C,D};
 
@@ -125,57 +186,25 @@ class Interval
 
 using IntvProc = array <Interval, MAX_TAPES>;
 using IntvProcIter = array <Interval, MAX_TAPES>::iterator;
-using DataBuff = array <char,CYG_CHAN_BLOCK>;
-using DataBuffIter = array <char,CYG_CHAN_BLOCK>::iterator;
+using Frame = array <short,CYG_CHANS>;     // one sample block, tape order
 using Files = array <OneFile,MAX_TAPES>;
 using FilesIter = array <OneFile,MAX_TAPES>::iterator;
 using chanMap = map<int,int>;
 
-// turn the bytes into shorts and shorts into bytes
-class Sample
-{
-   public:
-      short sample[CYG_CHANS];
-      short & operator[] (int idx) {return sample[idx];}
-      void toShort(DataBuff bytes) {
-         size_t i, j;
-         unsigned char y_l, y_h;
-         j = 0;
-         for (i = 0; i < sizeof(DataBuff); i+= 2) {
-            y_l = bytes[i];
-            y_h = bytes[i+1];
-            sample[j] = y_l + 256 * y_h;
-            ++j;
-         }
-      }
-
-      DataBuff toBytes() {
-         DataBuff buff;
-         short val;
-         int i, j, y_l, y_h;
-         j = 0;
-         for (i = 0; i < CYG_CHANS ; ++i) {
-            val = sample[i];
-            y_l = val & 0xff;
-            y_h = (val & 0xff00) >> 8;
-            buff[j] = y_l;
-            buff[j+1] = y_h;
-            j += 2;
-         }
-         return buff;
-      }
-};
-
 // globals
 Files FList;
 string OutName;
 string OutTag("_25KHz");
 off_t totalBytes;
-unsigned long long feedback, throttle;
+atomic<unsigned long long> feedback(0);   // bytes done, all tapes
+mutex ConsoleLock;      // tape threads share the console
 bool OverWrite = false;
 bool HaveRaw = false;
 bool HaveArgs = false;
 bool Debug = false;
+int NumThreads = 0;     // upsampling threads per tape, 0 to share the cores
+enum RESAMPLER {LINEAR, SINC};
+RESAMPLER Resampler = LINEAR;
 
 // The order of chans in a cygnus data block recording is not 1,2,3, etc.
 // This is the index into the data given chan#.
@@ -200,10 +229,6 @@ const chanMap rev_cmap = {
 };
 
 using dataRates = map<int,vector<double>>;
-using daq25 = vector<double>;
-using daq25Iter = daq25::iterator;
-using daq24 = vector<double>;
-using daq24Iter = daq25::iterator;
 
 static void usage(char * name)
 {
@@ -213,6 +238,8 @@ static void usage(char * name)
 "[-b B_Tape_filename,timing_pulse_chan] "\
 "[-c C_Tape_filename,timing_pulse_chan] "\
 "[-d D_Tape_filename,timing_pulse_chan] "\
+"[-j threads] "\
+"[-resampler=linear|sinc] "\
 "\n\n"\
 "Read one or more Cygnus recordings from an experiment and make new Cygnus files\n"\
 "that have a constant number of samples per timing pulse\n"\
@@ -220,6 +247,19 @@ static void usage(char * name)
 "\nThis can be used in a command line prompt mode, or using command line arguments.\n"\
 "If there are no arguments, the program will prompt for input.\n"\
 "If using command line arguments, use commas with no spaces\n"\
+"The tapes are done at the same time. -j is the number of threads that upsample\n"\
+"each tape, the default shares the cores among the tapes. -D does one tape\n"\
+"at a time with one thread.\n"\
+"-resampler=linear, the default, puts each new sample on a line between the two\n"\
+"24 KHz samples around it. sinc uses a 32 tap windowed sinc, which keeps more of\n"\
+"the high frequencies, flat to about 9 KHz.\n"\
+"Timing pulses that are missing, early, late or spurious are put right, and\n"\
+"where the tape has lost sync, 1.5 intervals or more with no pulse, the output\n"\
+"is -32768 on every chan. Intervals that are just off, or a pulse early or late\n"\
+"by 30 samples or less, are upsampled as they are, to 5000 samples each.\n"\
+"Each of these is a line in <output>.repairs.tsv, written for every tape.\n"\
+"-32768 can also be a real sample and cyg2daq does not treat it as a gap, so the\n"\
+"repairs file is the only record of which blocks were filled, keep it.\n"\
 "This must be run from the directory containing the Cygnus files.\n"\
 "\n"\
 ,name);
@@ -234,6 +274,8 @@ static bool parse_args(int argc, char *argv[])
                                    {"d", required_argument, NULL, 'd'},
                                    {"h", no_argument, NULL, 'h'},
                                    {"D", no_argument, NULL, 'D'},
+                                   {"j", required_argument, NULL, 'j'},
+                                   {"resampler", required_argument, NULL, 'r'},
                                    { 0,0,0,0} };
    int cmd;
    bool ret = true;
@@ -286,6 +328,21 @@ static bool parse_args(int argc, char *argv[])
                Debug = true;
                cout << "Debug turned on." << endl;
                break;
+         case 'j':
+               NumThreads = atoi(optarg);
+               break;
+         case 'r':
+               arg = optarg;
+               if (arg == "linear")
+                  Resampler = LINEAR;
+               else if (arg == "sinc")
+                  Resampler = SINC;
+               else
+               {
+                  cout << "Unknown -resampler: " << arg << endl;
+                  ret = false;
+               }
+               break;
          case 'h':
          case '?':
          default:
@@ -297,102 +354,67 @@ static bool parse_args(int argc, char *argv[])
    return ret;
 }
 
-/* Template of linspace function used in octave prototype.
-   Due to roundoff error, the last element may not exactly be
-   the 'to' value. We make sure it is.
+/* A line from one of the tape threads. A whole line at a time, so the
+   tapes' messages do not run into each other or the progress.
 */
-template <typename T> vector<T> linspace(T from, T to, size_t steps) 
-{
-   T step = (to - from) / static_cast<T>(steps-1);
-   vector<T> ticks(steps);
-   T val;
-   typename vector<T>::iterator x;
-   for (x = ticks.begin(), val = from; x != ticks.end()-1; ++x, val += step)
-      *x = val;
-   *x = to;
-   return ticks;
+static void say(const string& text)
+{
+   lock_guard<mutex> guard(ConsoleLock);
+   cout << "\r" << text << endl;
 }
 
-/* Find the next timing pulse in a cygnus file. 
-   The file will be position on peak sample position.
-   That is, the next read will read the peak.
+
+/* Find every timing pulse in a cygnus file, after the header sector.
+   Each pulse is searched for starting from the peak of the one before,
+   the same as looking for them one at a time. Use the saved index if
+   there is a good one, otherwise make it.
 */
-static bool next_pulse(FilesIter& cygfile, Interval& intv)
+static void find_file_pulses(FilesIter& cygfile)
 {
-   off_t blk = 0;
    int chan;
-   unsigned char sample_l, sample_h;
-   short sample;
-   bool found = false;
-   bool find_peak = false;
-   unsigned short max_sample = 0;
-   int mono_pos = 0;
-   DataBuff inbuff;
-   DataBuffIter iter;
-   off_t samps_in_block = 0;
-   if (Debug) cout << endl << "FIND NEXT PEAK" << endl;
-   intv.reset();
-   chan = rev_cmap.at(cygfile->SyncChan) - 1;
+   const off_t first = CYG_BUFF_SIZ / CYG_CHAN_BLOCK;
 
-   while (!found)
+   if (cygfile->SyncChan < 1 || cygfile->SyncChan > CYG_CHANS)
    {
-      if (!cygfile->InStrm.eof())
-      {
-         blk = cygfile->InStrm.tellg(); // current position
-         cygfile->InStrm.read(inbuff.data(),CYG_CHAN_BLOCK);
-         if (cygfile->InStrm.eof()) // if we found EOF and no peak, the previous peak
-            return false;           // we found was the last one. Tell caller.
-         ++samps_in_block;
-      }
+      cout << "FATAL ERROR: Timing pulse channel for " << cygfile->InName << " must be 1 to " << CYG_CHANS
+           << ", not " << cygfile->SyncChan << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   chan = rev_cmap.at(cygfile->SyncChan) - 1;
+   cygfile->NextPulse = 0;
+   if (cygfile->Pulses.load(cygfile->InName, cygfile->SyncChan, first))
+      say("Using timing pulses saved in " + cygfile->Pulses.name());
+   else
+   {
+      say("Searching for timing pulses in " + cygfile->InName);
+      if (cygfile->Pulses.build(cygfile->InName, cygfile->SyncChan, chan, first))
+         say("Saved them in " + cygfile->Pulses.name());
       else
-      {
-         cout << "EOF" << endl;
-         return false;
-      }
-
-      iter = inbuff.begin() + 2 * chan;  // timing pulse offset
-      sample_l = *iter++;
-      sample_h = *iter;
-      sample = sample_l + 256 * sample_h;
-      if (find_peak)  // are in pulse, find max
-      {
-         if (max_sample < sample)
-         {
-            max_sample = sample; // possible peak
-            intv.Peak = blk;
-            intv.PeakBlock = blk/CYG_CHAN_BLOCK;
-         }
-         else if (max_sample > sample) // assumes strictly monotonic
-         {
-            if(Debug){cout << " +++ PEAK at byte: " << intv.Peak << " block:" << intv.PeakBlock << " value: " << max_sample << endl;}
-            cygfile->InStrm.seekg(intv.Peak); // done, position on peak
-            found = true;
-         }
-      }
-      else if (sample <= 0)
-      {
-         intv.Peak = mono_pos = 0;  // start over on negative voltage
-      }
-      else if (sample > 0 && intv.Peak == 0) // found a positive
-      {
-         intv.Peak = blk;
-         mono_pos = 0;
-         max_sample = sample;
-      }
-      else if (sample > 0 && sample > max_sample) // rising signal
-      {
-         max_sample = sample;
-         ++mono_pos;
-         if (mono_pos == 10) // looks like we're in a good pulse, look for peak
-            find_peak = true;
-      }
-      else if (sample > 0 && sample < max_sample) // falling sig, keep looking
-      {
-         max_sample = sample;
-         intv.Peak = blk;
-         mono_pos = 0;
-      }
+         say("Could not save them in " + cygfile->Pulses.name() + ", continuing.");
    }
+   if (cygfile->Pulses.size(RESTART_AT_FALL) < 2)
+   {
+      cout << "FATAL ERROR: " << cygfile->InName << " does not have two timing pulses or the channel number is wrong."
+           << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   if (Debug) cout << "Found " << cygfile->Pulses.size(RESTART_AT_FALL) << " timing pulses, tape hash "
+                   << hex << cygfile->Pulses.hash() << dec << endl;
+}
+
+
+/* Hand out the next timing pulse in a cygnus file. 
+   False when there are no more.
+*/
+static bool next_pulse(FilesIter& cygfile, Interval& intv)
+{
+   if (Debug) cout << endl << "FIND NEXT PEAK" << endl;
+   intv.reset();
+   if (cygfile->NextPulse >= cygfile->Pulses.size(RESTART_AT_FALL))
+      return false;
+   intv.PeakBlock = cygfile->Pulses.pulses(RESTART_AT_FALL)[cygfile->NextPulse++].top;
+   intv.Peak = intv.PeakBlock * CYG_CHAN_BLOCK;
+   if(Debug){cout << " +++ PEAK at byte: " << intv.Peak << " block:" << intv.PeakBlock << endl;}
    return true;
 }
 
@@ -403,14 +425,12 @@ static bool next_pulse(FilesIter& cygfile, Interval& intv)
 void open_files()
 {
    FilesIter iter;
-   struct stat info;
 
    for (iter = FList.begin(); iter != FList.end(); ++iter)
    {
       if (iter->InName.length())
       {
-         iter->InStrm.open(iter->InName.c_str(),ios::binary);
-         if (!iter->InStrm.is_open())
+         if (!iter->Tape.open(iter->InName))
          {
             cout << "FATAL ERROR: Could not open " << iter->InName << endl << "exiting. . ." << endl;
             exit(1);
@@ -419,14 +439,10 @@ void open_files()
          if (!iter->OutStrm.is_open())
          {
             cout << "FATAL ERROR: Could not open output file " << iter->OutName << endl << "Exiting. . ." << endl;
-            iter->InStrm.close();
+            iter->Tape.close();
             exit(1);
          }
-          // size of files
-         FILE* fd = fopen(iter->InName.c_str(),"r");
-         fstat(fileno(fd),&info);
-         totalBytes += info.st_size;  // bytes in all files
-         fclose(fd);
+         totalBytes += iter->Tape.size();  // bytes in all files
       }
    }
 }
@@ -436,271 +452,807 @@ void open_files()
 static void copy_header(FilesIter& iter)
 {
    char buff[CYG_BUFF_SIZ];
-   iter->InStrm.read(buff,sizeof(buff));
+   iter->Tape.read(buff,sizeof(buff));
    iter->OutStrm.write(buff,sizeof(buff));
 }
 
+/* Copy len bytes of the input, from byte from, to the end of the output,
+   or up to the end of the input if it is shorter. The kernel copies them
+   with copy_file_range if it can, else they go through a large buffer.
+   The streams are left just past what was copied. Returns bytes copied.
+*/
+static off_t copy_range(FilesIter& iter, off_t from, off_t len)
+{
+   off_t out_at, done = 0;
+   ssize_t res = 0;
+   int in_fd, out_fd;
+   bool kernel = true;
+   vector<char> buff;
+   struct stat info;
+
+   iter->OutStrm.flush();
+   out_at = iter->OutStrm.tellp();
+   in_fd = open(iter->InName.c_str(), O_RDONLY);
+   out_fd = open(iter->OutName.c_str(), O_WRONLY);
+   if (in_fd < 0 || out_fd < 0 || out_at < 0 || fstat(in_fd, &info) < 0)
+   {
+      cout << "FATAL ERROR: Could not reopen " << iter->InName << " or " << iter->OutName
+           << " to copy it, " << strerror(errno) << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   len = max<off_t>(0, min(len, info.st_size - from));
+   while (done < len)
+   {
+      size_t want = len - done;
+      if (kernel)
+      {
+         off_t in_off = from + done, out_off = out_at + done;
+         res = copy_file_range(in_fd, &in_off, out_fd, &out_off, want, 0);
+         if (res < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+         {
+            kernel = false;   // not on this kernel or file system
+            buff.resize(COPY_BUFF_SIZ);
+            continue;
+         }
+      }
+      else
+      {
+         res = pread(in_fd, buff.data(), min(want, buff.size()), from + done);
+         if (res > 0)
+         {
+            ssize_t part, wrote = 0;
+            while (wrote < res && (part = pwrite(out_fd, buff.data() + wrote, res - wrote, out_at + done + wrote)) > 0)
+               wrote += part;
+            if (wrote < res)
+               res = -1;
+         }
+      }
+      if (res < 0 && errno == EINTR)
+         continue;
+      if (res < 0)
+      {
+         cout << "FATAL ERROR: Could not copy " << iter->InName << " to " << iter->OutName
+              << ", " << strerror(errno) << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+      if (res == 0)   // input got shorter
+         break;
+      done += res;
+   }
+   close(in_fd);
+   close(out_fd);
+   iter->OutStrm.seekp(out_at + done);
+   iter->Tape.seek(from + done);
+   return done;
+}
+
 // Copy every sample up to the first peak timing pulse
 // Leave the file position at that peak sample location
 // and return the interval values.
 static Interval copy_to_first(FilesIter& iter)
 {
    Interval first;
-   off_t start, count;
-   char val[1];
+   off_t start;
 
-   start = iter->InStrm.tellg();
+   start = iter->Tape.tell();
    next_pulse(iter, first);
-   iter->InStrm.seekg(start);
-   while (start++ < first.Peak)
+   copy_range(iter, start, first.Peak - start);
+   return first;
+}
+
+
+/* Weights for upsampling a timing pulse interval of some number of 24 KHz
+   samples to DAQ_INTV 25 KHz samples. Step j is between input samples j
+   and j+1 of the interval. Each 25 KHz sample has a slot, the step it is
+   in and how far along it, weight of the way from j. A normal interval has
+   1 or 2 in a step, an irregular short one can have more, a long one none
+   in some. The first interval of a file has its own, it starts with a 24
+   KHz sample as is and spreads the rest over a slightly wider grid. Each
+   thread keeps one and make_kernel fills it in again for every interval,
+   the slots are only allocated when it grows.
+*/
+class ResampleKernel
+{
+   public:
+      struct Slot
+      {
+         int step;
+         double weight;
+      };
+      vector<Slot> slots;     // the 25 KHz samples made, in order
+      int steps = 0;          // input samples less one
+      bool complete = false;  // all of the target slots are used
+};
+
+/* The linspace function of the octave prototype, a value at a time. Due to
+   roundoff error the running sum may not end exactly on to, so the last
+   value is to. These are the doubles the time axes always had.
+*/
+class TimeAxis
+{
+   public:
+      TimeAxis(double from, double to, size_t steps)
+         : To(to), Step((to - from) / static_cast<double>(steps-1)), Val(from), Left(steps) {}
+      double tick() const {return Left == 1 ? To : Val;}
+      void next() {Val += Step; --Left;}
+      bool done() const {return Left == 0;}
+   private:
+      double To;
+      double Step;
+      double Val;
+      size_t Left;
+};
+
+/* The walk along the two time axes for interval number interval, 0 is the
+   first one of the file. The times are from the first peak, not from this
+   interval's own, and the same doubles as when this was done with linspace,
+   so the weights, and the output, are the same to the last bit. A kernel
+   for one length is not the same for every interval.
+*/
+static void make_kernel(ResampleKernel& kern, int samples, off_t interval, bool first)
+{
+   int err = samples - IDEAL_CYG;
+   double last = interval * DAQ_INTV_TIME;
+   double in, in_next;
+
+   kern.slots.clear();
+   kern.steps = max(samples - 1, 0);
+   kern.complete = false;
+   if (samples < 2)
+      return;
+   TimeAxis tick24(last, last + (IDEAL_CYG + err)/(CYG_RATE+5*err), samples);
+   TimeAxis tick25(first ? last : last + DAQ_RATE_SEC, last + DAQ_INTV/DAQ_RATE, DAQ_INTV);
+   if (first)
+      tick25.next();   // [0] of the first is not interpolated
+   in = tick24.tick();
+   tick24.next();
+   for (int step = 0; step < kern.steps; ++step)
    {
-      iter->InStrm.read(val,sizeof(val));
-      iter->OutStrm.write(val,sizeof(val));
-      ++count;
+      in_next = tick24.tick();
+      while (!tick25.done() && tick25.tick() >= in && tick25.tick() <= in_next)
+      {
+         kern.slots.push_back({step, (tick25.tick() - in) / (in_next - in)});
+         tick25.next();
+      }
+      in = in_next;
+      tick24.next();
    }
-   return first;
+   kern.complete = tick25.done();
 }
 
+/* One 25 KHz sample block, weight of the way from left to right. Each
+   value is worked out in double and truncated, as it always has been.
+*/
+static void interp_frame_scalar(const short* left, const short* right, double weight, short* out)
+{
+   for (int chan = 0; chan < CYG_CHANS; ++chan)
+      out[chan] = left[chan] + weight * (right[chan]-left[chan]);
+}
 
-// Setups done, upsample nominal 24Khz file to 25Khz file
-static void adjust_file(FilesIter& iter)
+#ifdef HAVE_X86_SIMD
+// Same as above, 4 chans at a time in double. No FMA, the rounding has to match.
+__attribute__((target("avx2")))
+static void interp_frame_avx2(const short* left, const short* right, double weight, short* out)
 {
-   Interval start, next;
-   char val[1];
-   off_t tick_count;
-   double d_src, d_tar;
-   double interpol;
-   double last24, last25;
-   daq25Iter outIter25;
-   daq24Iter inIter24;
-   DataBuff outBuff;
-   DataBuff sampBytes;
-   Sample left,right, result;
-   int err;
-   daq24 tick24;
-   daq25 tick25;
-   int num_samp = 0;
-   off_t block = 1;
+   const __m256d w = _mm256_set1_pd(weight);
+   __m128i res[CYG_CHANS/4];
 
-   copy_header(iter);
-   start = copy_to_first(iter);
-   feedback += start.Peak;
+   for (int quad = 0; quad < CYG_CHANS/4; ++quad)
+   {
+      __m128i l = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(left + quad*4)));
+      __m128i r = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(right + quad*4)));
+      __m256d diff = _mm256_cvtepi32_pd(_mm_sub_epi32(r, l));
+      res[quad] = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_cvtepi32_pd(l), _mm256_mul_pd(w, diff)));
+   }
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(res[0], res[1]));
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_packs_epi32(res[2], res[3]));
+}
+#endif
+
+static void (*interp_frame)(const short*, const short*, double, short*) = interp_frame_scalar;
+
+/* The sinc resampler's filter bank. Filter p is for a 25 KHz sample p /
+   SINC_PHASES of the way from one 24 KHz sample to the next, its SINC_TAPS
+   taps go on the samples from SINC_HALF-1 before that one to SINC_HALF
+   after. Each is a low pass sinc at SINC_CUTOFF of the 24 KHz Nyquist, so
+   what folds back from above it is small, Kaiser windowed and scaled to
+   sum to 1.
+*/
+vector<float> SincBank;   // SINC_PHASES filters, SINC_TAPS each
+
+static double bessel_i0(double x)
+{
+   double sum = 1.0, term = 1.0;
+   for (int k = 1; term > sum * 1e-12; ++k)
+   {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+   }
+   return sum;
+}
+
+static void make_sinc_bank()
+{
+   vector<double> taps(SINC_TAPS);
 
-    // first sample is special, no interpolation
-   next_pulse(iter, next); 
-   iter->InStrm.seekg(start.Peak); // back up so we read this
-   tick_count = next.PeakBlock - start.PeakBlock;
-   err = tick_count - IDEAL_CYG;
-   if (Debug) cout << "err: " << err << endl;
-   tick24 = linspace<double> (0.0, (IDEAL_CYG + err)/(CYG_RATE+5*err), IDEAL_CYG+err); 
-   tick25 = linspace<double> (0.0, DAQ_INTV/DAQ_RATE, DAQ_INTV); 
-   iter->InStrm.read(sampBytes.data(),sampBytes.size());
-   feedback += sampBytes.size();
-   ++throttle;
-   right.toShort(sampBytes);
-   for (int chan = 0; chan < CYG_CHAN_BLOCK; ++chan)
-      outBuff[chan] = sampBytes[chan];
-   iter->OutStrm.write(outBuff.data(),outBuff.size());
-   if (Debug) cout << "dest idx 0 is not between anything, it starts the sequence" << endl;
-   left = right;
-   int how_many24 = 1;
-   int how_many25 = 1;
-   outIter25 = tick25.begin() + 1; // used index 0 above
-   inIter24 = tick24.begin();      // first interpolation is between [0] and [1]
-   for ( ; inIter24 != tick24.end()-1; ++inIter24)
+   SincBank.resize(SINC_PHASES * SINC_TAPS);
+   for (int phase = 0; phase < SINC_PHASES; ++phase)
    {
-      iter->InStrm.read(sampBytes.data(),sampBytes.size());
-      feedback += sampBytes.size();
-      ++throttle;
-      ++how_many24;
-      right.toShort(sampBytes);
-      if (*outIter25 >= *inIter24 && *outIter25 <= *(inIter24+1))
+      double sum = 0.0;
+      for (int tap = 0; tap < SINC_TAPS; ++tap)
       {
-         ++num_samp;
-         if (*(outIter25+1) >= *inIter24 && *(outIter25+1) <= *(inIter24+1))
-            ++num_samp;  // 2 25KHz samples in on 24Khz interval
+         double x = tap - (SINC_HALF - 1) - static_cast<double>(phase) / SINC_PHASES;
+         double arg = M_PI * SINC_CUTOFF * x;
+         double ratio = x / SINC_HALF;
+         taps[tap] = (x == 0.0 ? 1.0 : sin(arg) / arg)
+                   * bessel_i0(SINC_BETA * sqrt(max(0.0, 1.0 - ratio * ratio))) / bessel_i0(SINC_BETA);
+         sum += taps[tap];
       }
-      else
+      for (int tap = 0; tap < SINC_TAPS; ++tap)
+         SincBank[phase * SINC_TAPS + tap] = taps[tap] / sum;
+   }
+}
+
+/* One 25 KHz sample block from SINC_TAPS 24 KHz ones in float, 16 chans
+   each, and a filter from the bank. The sums are rounded and clipped to
+   a short.
+*/
+static void sinc_frame_scalar(const float* in, const float* taps, short* out)
+{
+   float acc[CYG_CHANS] = {};
+
+   for (int tap = 0; tap < SINC_TAPS; ++tap, in += CYG_CHANS)
+      for (int chan = 0; chan < CYG_CHANS; ++chan)
+         acc[chan] += in[chan] * taps[tap];
+   for (int chan = 0; chan < CYG_CHANS; ++chan)
+      out[chan] = max(-32768L, min(32767L, lrintf(acc[chan])));
+}
+
+#ifdef HAVE_X86_SIMD
+// Same as above, 8 chans a register. No FMA, so it matches the scalar one.
+__attribute__((target("avx2")))
+static void sinc_frame_avx2(const float* in, const float* taps, short* out)
+{
+   __m256 lo = _mm256_setzero_ps();
+   __m256 hi = _mm256_setzero_ps();
+
+   for (int tap = 0; tap < SINC_TAPS; ++tap, in += CYG_CHANS)
+   {
+      const __m256 w = _mm256_set1_ps(taps[tap]);
+      lo = _mm256_add_ps(lo, _mm256_mul_ps(_mm256_loadu_ps(in), w));
+      hi = _mm256_add_ps(hi, _mm256_mul_ps(_mm256_loadu_ps(in + 8), w));
+   }
+     // packs works within 128 bit lanes, put the quads back in order after
+   __m256i res = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+   res = _mm256_permute4x64_epi64(res, 0xd8);
+   _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), res);
+}
+#endif
+
+static void (*sinc_frame)(const float*, const float*, short*) = sinc_frame_scalar;
+
+static void pick_interp()
+{
+#ifdef HAVE_X86_SIMD
+   if (__builtin_cpu_supports("avx2"))
+   {
+      interp_frame = interp_frame_avx2;
+      sinc_frame = sinc_frame_avx2;
+   }
+#endif
+   if (Resampler == SINC)
+      make_sinc_bank();
+}
+
+/* Upsample one interval with kern. Step j interpolates from left, which
+   is in[j-1] after the first step, to in[j]. left is the last input used on
+   return. The 25 KHz samples go in out, dest is the index of the first of
+   them, for Debug. Returns the number of them.
+*/
+static int upsample_interval(const ResampleKernel& kern, Frame& left, const Frame* in, Frame* out, int dest)
+{
+   double interpol;
+   int made = 0;
+
+   for (const ResampleKernel::Slot& slot : kern.slots)
+   {
+      const Frame& lp = slot.step ? in[slot.step - 1] : left;
+      const Frame& right = in[slot.step];
+       // upscale into out
+      interpol = slot.weight;
+      interp_frame(lp.data(), right.data(), interpol, out[made].data());
+      if (Debug) 
+      {
+         cout << "dest idx " << dest + made
+              << " is between " << slot.step << " and " << slot.step + 1
+              << " Time scale is " << interpol << endl;
+         if (lp[15] > 20) // just timing pulse part
+            cout << "Orig is: " << lp[15] << " New is: " <<  lp[15] + interpol * (right[15]-lp[15]) << endl;
+      }
+      ++made;
+      if (Debug && made < static_cast<int>(kern.slots.size()) && kern.slots[made].step == slot.step)
+         cout << "New one" << endl;   // we are making a new out pt betwee two in points
+   }
+   if (kern.steps)
+      left = in[kern.steps - 1];
+   return made;
+}
+
+
+/* The same interval as upsample_interval, with the sinc filters. Each
+   25 KHz sample goes where the linear one would, step j of the kernel
+   is weight of the way from block base + j to the next one, using the
+   nearest filter in the bank. in holds the blocks from SINC_HALF-1 before
+   base to SINC_HALF after the last step, as floats. Returns the number of
+   samples made.
+*/
+static int upsample_interval_sinc(const ResampleKernel& kern, const float* in, Frame* out)
+{
+   int made = 0;
+
+   for (const ResampleKernel::Slot& slot : kern.slots)
+   {
+      int phase = lrint(slot.weight * SINC_PHASES);
+      size_t block = slot.step + phase / SINC_PHASES;   // weight near 1 is the next block's phase 0
+      phase %= SINC_PHASES;
+      sinc_frame(in + block * CYG_CHANS, SincBank.data() + phase * SINC_TAPS, out[made++].data());
+   }
+   return made;
+}
+
+
+/* One interval, peak to peak, of the upsampling, worked out before any of
+   it is done. The input sample blocks from inFrom are read, the first is
+   the left side of the kernel's first step, which goes to the one back
+   blocks on. interval is its number on the 25 KHz grid, which the kernel
+   is made for. The first interval of a file also writes its first block
+   as is. A dropout has no kernel, fill intervals of GAP_MARKER blocks are
+   written instead. Output goes at byte outAt.
+*/
+struct IntervalJob
+{
+   off_t interval;
+   off_t inFrom;
+   int back;
+   bool first;
+   off_t outAt;
+   off_t blocks;   // input blocks, peak to peak
+   int fill;
+};
+
+/* Sort out the intervals of a tape from start on and make the jobs for
+   them. An interval more than PULSE_SLACK samples off IDEAL_CYG is one of
+
+      early     more than PULSE_MOVE short, or long, but the pulse after
+      late      it is where it should be, so this one is moved halfway
+                between. Closer than that it is irregular, not moved
+      spurious  under half an interval, or the pulse after it is one
+                interval on, the pulse is noise and is dropped, the
+                interval runs on to the pulse after it
+      missing   close to 2 or more intervals long, one or more pulses did
+                not make it onto the tape, they are put in evenly spaced
+      dropout   1.5 intervals or more otherwise, the tape lost sync or the
+                data. The time is taken as the nearest number of
+                intervals and they are filled with GAP_MARKER
+      irregular anything else, the pulses are just off, it is upsampled
+                as it is to DAQ_INTV samples like any other interval
+
+   The timing of the output stays on the 25 KHz grid whatever was found,
+   so the tapes of an experiment still line up. Each decision is a line
+   in the repair log, <output>.repairs.tsv, which is always written so a
+   tape with no repairs has just the heading. Returns the last peak used,
+   outEnd is where its output ends.
+*/
+static Interval plan_intervals(FilesIter& iter, Interval start, vector<IntervalJob>& jobs, off_t& outEnd)
+{
+   ResampleKernel kern;
+   off_t interval = 0;
+   vector<off_t> peaks;
+   Interval next;
+   off_t from = start.PeakBlock;
+   off_t outAt = start.Peak;   // the header and lead-in are copied as is
+   off_t ticks;
+   int periods;
+   size_t idx = 0;
+   string logName = iter->OutName.substr(0, iter->OutName.find_last_of('.')) + REPAIR_EXT;
+   ofstream repairs(logName);
+   int repaired = 0;
+   int irregular = 0;
+
+   if (!repairs)
+   {
+      cout << "FATAL ERROR: Could not open repair log " << logName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   repairs << "tape\tclass\tstart_block\tend_block\tsamples\tpulse_block\taction\tout_block\tout_blocks" << endl;
+   auto log = [&] (const char* kind, off_t end, off_t pulse, const char* action, off_t outBlocks) {
+                  repairs << iter->InName << '\t' << kind << '\t' << from << '\t' << end << '\t'
+                          << end - from << '\t' << pulse << '\t' << action << '\t'
+                          << outAt / CYG_CHAN_BLOCK << '\t' << outBlocks << endl;};
+   auto add = [&] (off_t to, int fill) {
+                  off_t blocks = to - from;
+                  if (Debug) cout << "err: " << blocks - IDEAL_CYG << endl;
+                  if (fill)
+                  {
+                     jobs.push_back({interval, to, 0, false, outAt, blocks, fill});
+                     outAt += fill * static_cast<off_t>(DAQ_INTV) * CYG_CHAN_BLOCK;
+                     interval += fill;
+                  }
+                  else
+                  {
+                     bool first = jobs.empty();
+                     make_kernel(kern, blocks, interval, first);
+                     if (!kern.complete)
+                     {
+                        cout << "FATAL ERROR: " << iter->InName << ", the interval from block " << from
+                             << " did not use all target slots" << endl << "Exiting. . ." << endl;
+                        exit(1);
+                     }
+                     if (first)
+                     {
+                        jobs.push_back({interval++, from, 1, true, outAt, blocks, 0});
+                        outAt += CYG_CHAN_BLOCK;   // the peak block as is
+                     }
+                     else
+                     {
+                          // see upsample_serial for which block is left
+                        int back = jobs.size() == 1 ? 1 : 2;
+                        jobs.push_back({interval++, from - back, back, false, outAt, blocks, 0});
+                     }
+                     outAt += kern.slots.size() * CYG_CHAN_BLOCK;
+                  }
+                  from = to;};
+   auto move = [&] (const char* kind) {
+                  off_t at = from + lround((peaks[idx + 1] - from) / 2.0);
+                  log(kind, peaks[idx + 1], peaks[idx], "dropped", 0);
+                  log(kind, peaks[idx + 1], at, "synthesized", 0);
+                  add(at, 0);
+                  add(peaks[idx + 1], 0);
+                  idx += 2;
+                  ++repaired;};
+
+   while (next_pulse(iter, next))
+      peaks.push_back(next.PeakBlock);
+   while (idx < peaks.size())
+   {
+      ticks = peaks[idx] - from;
+      periods = lround(static_cast<double>(ticks) / IDEAL_CYG);
+        // the pulse after this one is two intervals on, or one
+      bool paired = idx + 1 < peaks.size() && labs(peaks[idx + 1] - from - 2 * IDEAL_CYG) <= 2 * PULSE_SLACK;
+      bool skips = idx + 1 < peaks.size() && labs(peaks[idx + 1] - from - IDEAL_CYG) <= PULSE_SLACK;
+      if (labs(ticks - IDEAL_CYG) <= PULSE_SLACK)
+         add(peaks[idx++], 0);
+      else if (ticks < IDEAL_CYG - PULSE_MOVE && paired)
+         move("early");
+      else if (ticks < IDEAL_CYG && (skips || ticks < IDEAL_CYG / 2))
       {
-         cout << "What? Should not be here #1." << endl;
+         log("spurious", peaks[idx], peaks[idx], "dropped", 0);
+         ++idx;
+         ++repaired;
       }
-      while (num_samp)
+      else if (periods >= 2 && labs(ticks - periods * IDEAL_CYG) <= periods * PULSE_SLACK)
       {
-          // upscale into outbuff
-         d_src = *(inIter24+1) - *inIter24;
-         d_tar = *outIter25 - *inIter24;
-         interpol = d_tar / d_src;
-         if (Debug) 
+         vector<off_t> at;
+         for (int missing = 1; missing < periods; ++missing)
          {
-            cout << "dest idx " << outIter25 - tick25.begin() 
-                 << " is between " 
-                 << inIter24-tick24.begin()
-                 << " and "
-                 << inIter24+1-tick24.begin() 
-                 << " Time scale is " << interpol << endl;
+            at.push_back(from + lround(static_cast<double>(ticks) * missing / periods));
+            log("missing", peaks[idx], at.back(), "synthesized", 0);
          }
-         for (int chan = 0; chan < CYG_CHANS; ++chan)
-         {
-            result[chan] = (left[chan] + interpol * (right[chan]-left[chan]));
-            if (Debug) 
-            {
-               if (chan == 15)
-               {
-                  if (left[chan] > 20)
-                     cout << "Orig is: " << left[chan] << " New is: " <<  left[chan] + interpol * (right[chan]-left[chan]) << endl;
-               }
-            }
-         }
-         outBuff = result.toBytes();
-         iter->OutStrm.write(outBuff.data(),outBuff.size());
-         ++how_many25;
-         ++outIter25;
-         --num_samp;
-         if (Debug){ if (num_samp) // we are making a new out pt betwee two in points
-                     cout << "New one" << endl;}
+         for (off_t pulse : at)
+            add(pulse, 0);
+         add(peaks[idx++], 0);
+         ++repaired;
+      }
+      else if (ticks > IDEAL_CYG + PULSE_MOVE && paired)
+         move("late");
+      else if (periods >= 2)
+      {
+         log("dropout", peaks[idx], 0, "filled", periods * static_cast<off_t>(DAQ_INTV));
+         add(peaks[idx++], periods);
+         ++repaired;
+      }
+      else
+      {
+         make_kernel(kern, peaks[idx] - from, interval, jobs.empty());
+         log("irregular", peaks[idx], 0, "resampled", kern.slots.size() + (jobs.empty() ? 1 : 0));
+         add(peaks[idx++], 0);
+         ++irregular;
       }
-      left =  right;
    }
-   if (Debug) cout << " wrote from peak " << start.PeakBlock << " to " << next.PeakBlock << endl;
-   start = next;
+   if (irregular)
+      say(iter->InName + ": " + to_string(irregular) + " irregular intervals upsampled as they are, see " + logName);
+   if (repaired)
+      say(iter->InName + ": " + to_string(repaired) + " timing repairs, see " + logName);
+   outEnd = outAt;
+   start.PeakBlock = from;
+   start.Peak = from * CYG_CHAN_BLOCK;
+   return start;
+}
 
-   if (Debug)
+// A dropout's output, fill intervals of marker blocks
+static void gap_frames(vector<Frame>& out)
+{
+   Frame marker;
+   marker.fill(GAP_MARKER);
+   out.assign(DAQ_INTV, marker);
+}
+
+
+/* Upsample the jobs from plan_intervals, one thread.
+   The tape is read once, front to back. Each interval, from one peak up to
+   the next, is read into memory in one go, upsampled from there, and
+   written in one go. The first interval's last sample is the left side of
+   the second one's first step. After that each interval's first step runs
+   from the sample two before its peak, the one just before is never used.
+   That is how it was done when each interval was read with a seek back to
+   its peak, and the output is kept the same. After a dropout the tape is
+   moved on to the next peak and that left sample read for itself.
+*/
+static void upsample_serial(FilesIter& iter, const vector<IntervalJob>& jobs)
+{
+   Frame left;
+   vector<Frame> in;
+   vector<Frame> out(DAQ_INTV);
+   vector<Frame> gap;
+   ResampleKernel kern;
+   int how_many25;
+
+   auto read_interval = [&] (off_t blocks) {
+                             in.resize(blocks);
+                             size_t got = iter->Tape.read(reinterpret_cast<char*>(in.data()), blocks * CYG_CHAN_BLOCK);
+                             feedback += got;};
+   auto write_out = [&] {iter->OutStrm.write(reinterpret_cast<char*>(out.data()), how_many25 * CYG_CHAN_BLOCK);};
+
+   for (const IntervalJob& job : jobs)
    {
-      cout << "Read " << how_many24 << " sample blocks" << endl;
-      cout << "Wrote " << how_many25 << " sample blocks" << endl;
+      const off_t from = job.inFrom + job.back;
+      if (job.fill)
+      {
+         gap_frames(gap);
+         for (int intv = 0; intv < job.fill; ++intv)
+            iter->OutStrm.write(reinterpret_cast<char*>(gap.data()), DAQ_INTV * CYG_CHAN_BLOCK);
+         feedback += job.blocks * CYG_CHAN_BLOCK;
+         if (Debug) cout << " filled " << job.fill << " intervals up to peak " << job.inFrom << endl;
+         continue;
+      }
+      make_kernel(kern, job.blocks, job.interval, job.first);
+      if (job.first)
+      {
+          // first sample is special, no interpolation
+         read_interval(job.blocks);
+         left = in[0];
+         iter->OutStrm.write(reinterpret_cast<char*>(left.data()), CYG_CHAN_BLOCK);
+         if (Debug) cout << "dest idx 0 is not between anything, it starts the sequence" << endl;
+         how_many25 = upsample_interval(kern, left, in.data() + 1, out.data(), 1);
+         write_out();
+         if (Debug)
+         {
+            cout << " wrote from peak " << job.inFrom << " to " << job.inFrom + job.blocks << endl;
+            cout << "Read " << kern.steps + 1 << " sample blocks" << endl;
+            cout << "Wrote " << how_many25 + 1 << " sample blocks" << endl;
+            cout << endl << "*** DO REST *** " << endl;
+         }
+         continue;
+      }
+      if (iter->Tape.tell() != from * CYG_CHAN_BLOCK)   // after a dropout
+      {
+         iter->Tape.read_at(job.inFrom * CYG_CHAN_BLOCK, reinterpret_cast<char*>(left.data()), CYG_CHAN_BLOCK);
+         iter->Tape.seek(from * CYG_CHAN_BLOCK);
+      }
+      read_interval(job.blocks);
+      how_many25 = upsample_interval(kern, left, in.data(), out.data(), 0);
+      write_out();
+      if (Debug)
+      {
+         cout << " wrote from peak " << from << " to " << from + job.blocks << endl;
+         cout << "Read " << kern.steps << " sample blocks" << endl;
+         cout << "Wrote " << how_many25 << " sample blocks" << endl;
+      }
    }
+}
+
+
+/* Read count sample blocks for upsample_interval_sinc, starting SINC_HALF-1
+   before base, into raw and as floats into flt. Where that runs into the
+   header or off the end of the tape the first or last block is repeated.
+   False if nothing could be read.
+*/
+static bool read_sinc_input(FilesIter& iter, off_t base, size_t count, vector<Frame>& raw, vector<float>& flt)
+{
+   const off_t lo = base - (SINC_HALF - 1);
+   const off_t first = max(lo, static_cast<off_t>(CYG_BUFF_SIZ / CYG_CHAN_BLOCK));
+   const off_t last = min(lo + static_cast<off_t>(count), iter->Tape.size() / CYG_CHAN_BLOCK);
+   size_t bytes;
+
+   if (last <= first)
+      return false;
+   raw.resize(count);
+   bytes = (last - first) * CYG_CHAN_BLOCK;
+   if (iter->Tape.read_at(first * CYG_CHAN_BLOCK, reinterpret_cast<char*>(raw.data() + (first - lo)), bytes) != bytes)
+      return false;
+   fill(raw.begin(), raw.begin() + (first - lo), raw[first - lo]);
+   fill(raw.begin() + (last - lo), raw.end(), raw[last - lo - 1]);
+   flt.resize(count * CYG_CHANS);
+   for (size_t blk = 0; blk < count; ++blk)
+      copy(raw[blk].begin(), raw[blk].end(), flt.begin() + blk * CYG_CHANS);
+   return true;
+}
 
-   // now do rest of file
-   if (Debug) cout << endl << "*** DO REST *** " << endl;
-   while (next_pulse(iter, next)) 
+/* The same as upsample_serial with NumThreads threads. plan_intervals
+   has worked out where each interval's input starts and where its output
+   goes, so the threads take intervals in turn, read them with read_at and
+   pwrite the results in place. The sinc resampler always comes here, a
+   kernel step j is from block inFrom + back - 1 + j, and -D uses one
+   thread.
+*/
+static void upsample_parallel(FilesIter& iter, const vector<IntervalJob>& jobs)
+{
+   atomic<size_t> nextJob(0);
+   atomic<int> failed(0);
+   vector<thread> pool;
+   int out_fd;
+
+   iter->OutStrm.flush();
+   out_fd = open(iter->OutName.c_str(), O_WRONLY);
+   if (out_fd < 0)
    {
-      num_samp = 0;
-      how_many24 = how_many25 = 0;
-      tick_count = next.PeakBlock - start.PeakBlock;
-      if (tick_count > IDEAL_CYG+10) // kind of arbitrary
-         cout << "Two timing pulses in this file are to far apart" << endl
-         << "Has this file been processed by cyg_fixup?" << endl
-         << "Results are probably incorrect." << endl;
-
-         // move along the time axis
-      err = tick_count - IDEAL_CYG;
-      if (Debug) cout << "err: " << err << endl;
-      last25 = block * DAQ_INTV_TIME; // next 25khz set of ticks
-      last24 = last25;
-      ++block;
-     tick25 = linspace<double> (last25+DAQ_RATE_SEC, last25+DAQ_INTV/DAQ_RATE, DAQ_INTV); 
-     tick24 = linspace<double> (last24, last24+(IDEAL_CYG + err)/(CYG_RATE+5*err), IDEAL_CYG+err); 
-       if (Debug) cout << "l24: " << last24 << " l25: " << last25 << endl;
-      // back up to start pulse
-      iter->InStrm.seekg(start.Peak);
-      outIter25 = tick25.begin();
-      inIter24 = tick24.begin();
-      for (  ; inIter24 != tick24.end()-1; ++inIter24)
+      cout << "FATAL ERROR: Could not reopen " << iter->OutName << ", " << strerror(errno)
+           << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   auto put = [&] (const vector<Frame>& out, int blocks, off_t at) {
+      const char* data = reinterpret_cast<const char*>(out.data());
+      ssize_t res;
+      for (size_t done = 0, len = blocks * CYG_CHAN_BLOCK; done < len; done += res)
       {
-         if (outIter25 == tick25.end())
+         res = pwrite(out_fd, data + done, len - done, at + done);
+         if (res <= 0 && errno != EINTR)
          {
-            cout << "25 end" << endl;
-            cout << "24 pos: " << tick24.end() - inIter24 << endl;
+            failed = errno ? errno : EIO;
+            return;
          }
-         iter->InStrm.read(sampBytes.data(),sampBytes.size());
-         right.toShort(sampBytes);
-         ++how_many24;
-         feedback += sampBytes.size();
-         ++throttle;
-         if (*outIter25 >= *inIter24 && *outIter25 <= *(inIter24+1))
+         res = max<ssize_t>(res, 0);
+      }
+   };
+   auto worker = [&] {
+      vector<Frame> in;
+      vector<float> flt;
+      vector<Frame> out(DAQ_INTV + 1);
+      ResampleKernel kern;
+      Frame left;
+      size_t idx;
+
+      while (!failed && (idx = nextJob++) < jobs.size())
+      {
+         const IntervalJob& job = jobs[idx];
+         int made = job.first ? 1 : 0;
+         if (job.fill)
          {
-            ++num_samp;
-            if (*(outIter25+1) >= *inIter24 && *(outIter25+1) <= *(inIter24+1))
-               ++num_samp;
+            gap_frames(out);
+            for (int intv = 0; intv < job.fill; ++intv)
+               put(out, DAQ_INTV, job.outAt + intv * static_cast<off_t>(DAQ_INTV) * CYG_CHAN_BLOCK);
+            out.resize(DAQ_INTV + 1);
+            feedback += job.blocks * CYG_CHAN_BLOCK;
+            continue;
          }
-         else
+         make_kernel(kern, job.blocks, job.interval, job.first);
+         if (Resampler == SINC)
          {
-            cout << "What? Should not be here #2." << endl;
+            if (!read_sinc_input(iter, job.inFrom + job.back - 1, kern.steps + SINC_TAPS, in, flt))
+            {
+               failed = EIO;
+               break;
+            }
+            out[0] = in[SINC_HALF - 1];
+            made += upsample_interval_sinc(kern, flt.data(), out.data() + made);
          }
-         while (num_samp)
+         else
          {
-               // upscale into outbuff
-            d_src = *(inIter24+1) - *inIter24;
-            d_tar = *outIter25 - *inIter24;
-            interpol = d_tar / d_src;
-            if (Debug) {cout << "dest idx " << outIter25 - tick25.begin() 
-                 << " is between " 
-                 << inIter24-tick24.begin()
-                 << " and "
-                 << inIter24+1-tick24.begin() 
-                 << " Time scale is " << interpol << endl; }
-            for (int chan = 0; chan < CYG_CHANS; ++chan)
+            size_t bytes = (job.back + kern.steps) * CYG_CHAN_BLOCK;
+            in.resize(job.back + kern.steps);
+            if (iter->Tape.read_at(job.inFrom * CYG_CHAN_BLOCK, reinterpret_cast<char*>(in.data()), bytes) != bytes)
             {
-               result[chan] = (left[chan] + interpol * (right[chan]-left[chan]));
-               if (Debug)
-               {
-                  if (chan == 15)
-                  {
-                     if (left[chan] > 20) // just timing pulse part
-                        cout << "Orig is: " << left[chan] << " New is: " <<  left[chan] + interpol * (right[chan]-left[chan]) << endl;
-                  }
-               }
+               failed = EIO;
+               break;
             }
-            outBuff = result.toBytes();
-            iter->OutStrm.write(outBuff.data(),outBuff.size());
-            ++outIter25;
-            --num_samp;
-            ++how_many25;
-            if (Debug) {if (num_samp) // we are making a new out pt betwee two in points
-               cout << "New one" << endl;}
+            left = in[0];
+            out[0] = in[0];
+            made += upsample_interval(kern, left, in.data() + job.back, out.data() + made, made);
          }
-         left =  right;
-      }
-      if (Debug) cout << " wrote from peak " << start.PeakBlock << " to " << next.PeakBlock << endl;
-      start = next;
-      if (outIter25 != tick25.end())
-         cout << "Unexpectedly did not use all target slots" << endl;
-      if (inIter24 != tick24.end()-1)
-         cout << "Unexpectedly did not use all source slots" << endl;
-      if (Debug)
-      {
-         cout << "Read " << how_many24 << " sample blocks" << endl;
-         cout << "Wrote " << how_many25 << " sample blocks" << endl;
-      }
-      if (throttle > 1024)
-      {
-         printf("\r  %3.0f%%",((double)feedback/totalBytes)*100.0);
-         fflush(stdout);
-         throttle = 0;
+         put(out, made, job.outAt);
+           // peak to peak, the same bytes upsample_serial counts
+         feedback += job.blocks * CYG_CHAN_BLOCK;
       }
+   };
+   for (int thr = 0; thr < (Debug ? 1 : NumThreads); ++thr)
+      pool.emplace_back(worker);
+   for (auto& thr : pool)
+      thr.join();
+   close(out_fd);
+   if (failed)
+   {
+      cout << endl << "FATAL ERROR: Could not upsample " << iter->InName << " to " << iter->OutName
+           << ", " << strerror(failed) << endl << "Exiting. . ." << endl;
+      exit(1);
    }
+}
+
+
+// Setups done, upsample nominal 24Khz file to 25Khz file
+static void adjust_file(FilesIter& iter)
+{
+   Interval start;
+   vector<IntervalJob> jobs;
+   off_t outEnd;
+
+   find_file_pulses(iter);
+   copy_header(iter);
+   start = copy_to_first(iter);
+   feedback += start.Peak;
+   start = plan_intervals(iter, start, jobs, outEnd);
+   if (Resampler == SINC || (NumThreads > 1 && !Debug))
+      upsample_parallel(iter, jobs);
+   else
+      upsample_serial(iter, jobs);
+   iter->OutStrm.seekp(outEnd);
 
    // Ran out of pulses. Copy rest of file without upscaling.
-   iter->InStrm.clear(); // no longer at eof
-   iter->InStrm.seekg(start.Peak);
-   while (!iter->InStrm.eof())
-   {
-      iter->InStrm.read(val,sizeof(val));
-      if (!iter->InStrm.eof())
-      {
-         iter->OutStrm.write(val,sizeof(val));
-         ++feedback;
-      }
-   }
+   feedback += copy_range(iter, start.Peak, numeric_limits<off_t>::max() - start.Peak);
+   iter->Tape.close();
+   iter->OutStrm.close();
+}
+
+
+static void show_progress()
+{
+   lock_guard<mutex> guard(ConsoleLock);
    printf("\r  %3.0f%%",((double)feedback/totalBytes)*100.0);
    fflush(stdout);
-   iter->InStrm.close();
-   iter->OutStrm.close();
 }
 
 
+/* Each tape is upsampled on its own thread, they have nothing in common
+   but the progress count, so every output is the same as when they are
+   done one after another. This thread shows the progress until they are
+   all done. -D does them one at a time here so the debug output makes
+   sense.
+*/
 static void adjust_timing()
 {
    FilesIter iter;
+   vector<thread> tapes;
+   int finished = 0;
+   mutex lock;
+   condition_variable alldone;
+
    open_files();
    for (iter = FList.begin(); iter != FList.end(); ++iter)
    {
       if (iter->InName.length())
       {
          cout << endl << "Processing " << iter->InName << endl;
-         adjust_file(iter);
+         if (Debug)
+         {
+            adjust_file(iter);
+            show_progress();
+         }
+         else
+            tapes.emplace_back([&, iter] () mutable {
+                                  adjust_file(iter);
+                                  lock_guard<mutex> guard(lock);
+                                  ++finished;
+                                  alldone.notify_one();});
       }
    }
+   {
+      unique_lock<mutex> waiting(lock);
+      while (!alldone.wait_for(waiting, chrono::milliseconds(200),
+                               [&] {return finished == static_cast<int>(tapes.size());}))
+         show_progress();
+   }
+   for (auto& thr : tapes)
+      thr.join();
+   show_progress();
 }
 
 
@@ -769,6 +1321,12 @@ int main (int argc, char **argv)
               << " sync chan: " << FList[file].SyncChan << endl;
       else
          cout << TAPES[file] << ": No file" << endl;
+   if (NumThreads <= 0)
+   {
+      int used = count_if(FList.begin(), FList.end(), [] (const OneFile& file) {return file.InName.length() > 0;});
+      NumThreads = max(1u, thread::hardware_concurrency() / max(used, 1));
+   }
+   pick_interp();
    adjust_timing();
    cout << endl << "DONE." << endl;
    return 0;
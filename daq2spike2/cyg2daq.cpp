@@ -21,6 +21,22 @@ This file is part of a collection of recording processing software.
 
 /*
    Read cygnus digital tape file(s) and make .daq file(s).
+
+   Mod History
+   Sun Oct 18 2026 Chan permutation is a constexpr table, sample blocks
+                   are reordered with SSSE3 shuffles when the cpu has them.
+                   Tapes are read through TapeReader, .daq records are
+                   written about 1 MB at a time.
+                   Up to 8 tapes, E-H go in a _65-128.daq file. -m manifest.
+                   A decode thread per tape feeds the record loop through a
+                   lock-free ring.
+                   Timing pulse search uses the shared cyg_pulse scanner.
+                   A tape's saved .pulses index is used when there is one.
+                   -subsample lines tapes up to a fraction of a sample by
+                   cross-correlating timing pulses, -realign N checks again
+                   every N pulses to follow drift.
+                   -smr writes a Spike2 .smr file directly, no .daq files.
+                   The samples go to it signed, as they are on the tape.
 */
 
 
@@ -41,14 +57,30 @@ This file is part of a collection of recording processing software.
 #include <errno.h>
 #include <dirent.h> 
 
-#include <map>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <array>
 #include <vector>
 #include <algorithm> 
+#include <limits>
+
+#include <memory>
+#include <thread>
+#include <cmath>
+#include <ctime>
+
+#include "cyg_tape.h"
+#include "spsc_ring.h"
+#include "cyg_pulse.h"
+#include "daq_smr.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
 
 using namespace std;
 
@@ -60,9 +92,17 @@ const int CYG_SAMP_SIZ = CYG_BUFF_SIZ/2; // 2 bytes per sample
 const int CYG_HEADER = 128;
 const int CYG_CHANS = 16;
 const off_t CYG_CHAN_BLOCK = CYG_CHANS * sizeof(short);
-const int MAX_TAPES = 4;
+const int MAX_TAPES = 8;
+const int TAPES_PER_DAQ = CHANS_PER_FILE / CYG_CHANS;  // 4 tapes per .daq file
+const int MAX_DAQS = MAX_TAPES / TAPES_PER_DAQ;
+const size_t DAQ_WRITE_RECS = 8192;      // .daq records per write, about 1 MB
+const int BATCH_FRAMES = 2048;           // sample blocks per decoded batch, 64 KB
+const int RING_BATCHES = 8;              // batches in flight per tape
+const off_t PULSE_MATCH_SLOP = 48;       // blocks a pulse may be from where it is expected
 
 string DAQ_EXT(".daq");
+string SMR_EXT("_from_cyg.smr");
+static_assert(DAQ_BUFF_SIZ == DAQ_REC_WORDS && CHANS_PER_FILE == DAQ_REC_CHANS, "-smr takes .daq records");
 
 #pragma pack(push,1) 
 using cygheader = struct 
@@ -80,74 +120,99 @@ using cygheader = struct
 };
 #pragma pack(pop)
 
+/* Fractional delay of a tape against the reference tape, in blocks, at
+   some output blocks. It is linear between them and flat past the ends.
+   The tape's block n + delay goes in output block n.
+*/
+class DelayPlan
+{
+   public:
+      vector<double> at;
+      vector<double> delay;
+      bool empty() const {return at.empty();}
+        // hint remembers where the last lookup was, blocks are asked for in order
+      double value(double blk, size_t& hint) const
+      {
+         while (hint + 1 < at.size() && at[hint+1] <= blk)
+            ++hint;
+         if (hint + 1 == at.size() || blk <= at[hint])
+            return delay[hint];
+         return delay[hint] + (delay[hint+1] - delay[hint]) * (blk - at[hint]) / (at[hint+1] - at[hint]);
+      }
+};
+
 class OneFile
 {
    public:
       OneFile() {memset(&header,0,sizeof(header));}
       string name = "";
-      ifstream fstrm;
+      TapeReader tape;
       cygheader header;
       int  sync_chan = 0;
       off_t peak = numeric_limits<off_t>::max();
+      PulseList pulses;   // the first pulse, or all of them for -realign
+      DelayPlan plan;     // for -subsample, empty for whole blocks
 };
-enum FILE_SLOT {A,B,C,D};
+enum FILE_SLOT {A,B,C,D,E,F,G,H};
 
-using chanMap = map<int,int>;
+using chanMap = array<int,CYG_CHANS+1>;   // 1-based, [0] is not used
 using InBuff = array <char,CYG_CHAN_BLOCK>;
 using InBuffIter = array <char,CYG_CHAN_BLOCK>::iterator;
-using OutBuff =  array <unsigned short,DAQ_BUFF_SIZ>;
 using FList = array <OneFile,MAX_TAPES>;
 
 // globals
 FList Files;
 string OutName;
+array<string,MAX_DAQS> DaqNames;
+const array<string,MAX_DAQS> DaqTags = {"1-64", "65-128"};
 string OutTag("_from_cyg_");
-bool OverWrite = false;
+string ManifestName;
 bool HaveRaw = false;
 bool HaveArgs = false;
 bool Debug = false;
+bool SubSample = false;
+int Realign = 0;        // pulses between alignment checks, 0 for just the first
+bool ToSmr = false;
+string SmrDate;         // empty to use tape A's header
+string SmrName;
 
 
 // this is the index of the sequential words in a sample block 
-chanMap cmap = {
-   {1, 1},
-   {2, 5},
-   {3, 9},
-   {4, 13},
-   {5, 3},
-   {6, 7},
-   {7, 11},
-   {8, 15},
-   {9, 2},
-   {10, 6},
-   {11, 10},
-   {12, 14},
-   {13, 4},
-   {14, 8},
-   {15, 12},
-   {16, 16}
-};
+constexpr chanMap cmap = {0, 1, 5, 9, 13, 3, 7, 11, 15, 2, 6, 10, 14, 4, 8, 12, 16};
 
 // This is the index into the data given chan#.
 // E.g. chan 8 is at index 14, or 13 for zero-based indexing.
-chanMap rev_cmap = {
-   {1, 1},
-   {2, 9},
-   {3, 5},
-   {4, 13},
-   {5, 2},
-   {6, 10},
-   {7, 6},
-   {8, 14},
-   {9, 3},
-   {10, 11},
-   {11, 7},
-   {12, 15},
-   {13, 4},
-   {14, 12},
-   {15, 8},
-   {16, 16}
-};
+constexpr chanMap rev_cmap = {0, 1, 9, 5, 13, 2, 10, 6, 14, 3, 11, 7, 15, 4, 12, 8, 16};
+
+constexpr bool maps_match()
+{
+   for (int idx = 1; idx <= CYG_CHANS; ++idx)
+      if (rev_cmap[cmap[idx]] != idx)
+         return false;
+   return true;
+}
+static_assert(maps_match(), "cmap and rev_cmap must be inverses");
+
+/* pshufb masks that put the 16 words of a sample block in chan order.
+   Output half h, chans 8h+1 to 8h+8, is the low input half shuffled with
+   shufMask[h][0] or'd with the high input half shuffled with shufMask[h][1].
+   A mask byte of 0x80 gives a 0 byte.
+*/
+using ShufMask = array<array<array<unsigned char,16>,2>,2>;
+constexpr ShufMask make_shuf_mask()
+{
+   ShufMask mask {};
+   for (int out = 0; out < CYG_CHANS; ++out)
+   {
+      int in = rev_cmap[out+1] - 1;
+      for (int half = 0; half < 2; ++half)
+         for (int byte = 0; byte < 2; ++byte)
+            mask[out/8][half][(out%8)*2 + byte] = in/8 == half ? (in%8)*2 + byte : 0x80;
+   }
+   return mask;
+}
+alignas(16) constexpr ShufMask shufMask = make_shuf_mask();
+
 
 static void usage(char * name)
 {
@@ -158,12 +223,30 @@ static void usage(char * name)
 "[-b B_Tape_filename,timing_pulse_chan] "\
 "[-c C_Tape_filename,timing_pulse_chan] "\
 "[-d D_Tape_filename,timing_pulse_chan] "\
+"[-e . . . -h E-H_Tape_filename,timing_pulse_chan] "\
+"[-m manifest_file] "\
 "-o outfile_name "\
+"[-subsample] [-realign N] "\
+"[-smr [\"YYYY-MM-DD hh:mm:ss\"]] "\
 "\n"\
 "Read one or more corrected and upscaled cygnus tapes from an experiment and "\
 "make a .daq file.\n"\
+"Tapes A-D go in the _1-64.daq file, tapes E-H, if any, in a _65-128.daq file\n"\
+"written at the same time with the same alignment.\n"\
+"A manifest file lists the tapes in A-H order, one filename,timing_pulse_chan\n"\
+"per line. Use a line with just - for an unused tape, # starts a comment.\n"\
+"-h with no tape name shows this help.\n"\
 "The timing pulse channels are used to align the tapes so the first timing pulse\n"\
-"occurs at the same sample time.\nNote: Use commas with no spaces\n\n"\
+"occurs at the same sample time.\n"\
+"-subsample lines the tapes up to a fraction of a sample by cross-correlating\n"\
+"their first timing pulses, and interpolates between samples to do it.\n"\
+"-realign N does -subsample and checks the alignment again every N timing pulses,\n"\
+"the delay is interpolated between checks to follow drift between tapes.\n"\
+"-smr writes a Spike2 outfile_name_from_cyg.smr file instead of .daq files, the\n"\
+"same as running daq2spike2 on them, except that -32768 stays -32768, a .daq file\n"\
+"makes it -32767. The date and time stamp is the one\n"\
+"daq2spike2 -t takes, the default is the one in the first tape's header.\n"\
+"Note: Use commas with no spaces\n\n"\
 "This can be used in a command line prompt mode, or using command line arguments.\n" \
 "\nIf there are no arguments, the program will prompt for input.\n" \
 "This must be run from the directory containing the cygnus files.\n"\
@@ -172,6 +255,58 @@ static void usage(char * name)
 
 }
 
+// Set a tape slot from "filename,timing_pulse_chan"
+static bool set_tape(int idx, const string& arg)
+{
+   vector <string> tokens;
+   stringstream strm(arg);
+   string str;
+
+   while (getline(strm,str,','))
+      tokens.push_back(str);
+   if (tokens.size() != 2 || tokens[0].empty())
+   {
+      cout << "FATAL: Tape " << static_cast<char>('A' + idx) << " needs filename,timing_pulse_chan, not "
+           << arg << endl;
+      return false;
+   }
+   Files[idx].name = tokens[0];
+   Files[idx].sync_chan = strtol(tokens[1].c_str(),nullptr,10);
+   return true;
+}
+
+// Read tapes A-H from a manifest, one filename,timing_pulse_chan per line
+static bool read_manifest()
+{
+   ifstream manifest(ManifestName);
+   string line;
+   int idx = 0;
+
+   if (!manifest.is_open())
+   {
+      cout << "FATAL: Could not open manifest " << ManifestName << endl;
+      return false;
+   }
+   while (getline(manifest, line))
+   {
+      size_t hash = line.find('#');
+      if (hash != string::npos)
+         line.erase(hash);
+      line.erase(remove_if(line.begin(), line.end(), ::isspace), line.end());
+      if (line.empty())
+         continue;
+      if (idx == MAX_TAPES)
+      {
+         cout << "FATAL: " << ManifestName << " lists more than " << MAX_TAPES << " tapes" << endl;
+         return false;
+      }
+      if (line != "-" && !set_tape(idx, line))
+         return false;
+      ++idx;
+   }
+   return true;
+}
+
 static bool parse_args(int argc, char *argv[])
 {
    static struct option opts[] = { 
@@ -179,44 +314,51 @@ static bool parse_args(int argc, char *argv[])
                                    {"b", required_argument, NULL, 'b'},
                                    {"c", required_argument, NULL, 'c'},
                                    {"d", required_argument, NULL, 'd'},
+                                   {"e", required_argument, NULL, 'e'},
+                                   {"f", required_argument, NULL, 'f'},
+                                   {"g", required_argument, NULL, 'g'},
+                                   {"h", optional_argument, NULL, 'h'},
+                                   {"m", required_argument, NULL, 'm'},
                                    {"o", required_argument, NULL, 'o'},
-                                   {"h", no_argument, NULL, 'h'},
-                                   {"f", no_argument, NULL, 'f'},
                                    {"D", no_argument, NULL, 'D'},
+                                   {"subsample", no_argument, NULL, 's'},
+                                   {"realign", required_argument, NULL, 'r'},
+                                   {"smr", optional_argument, NULL, 'S'},
                                    { 0,0,0,0} };
    int cmd;
    bool ret = true;
    opterr = 0;
-   string arg;
-   vector <string> tokens;
-
-   auto tokenize = [&](FILE_SLOT idx) {tokens.clear(); stringstream strm(arg);string str; 
-                                       while(getline(strm,str,',')) tokens.push_back(str);
-                                       Files[idx].name = tokens[0];
-                                       Files[idx].sync_chan = strtol(tokens[1].c_str(),nullptr,10);};
 
    while ((cmd = getopt_long_only(argc, argv, "", opts, NULL )) != -1)
    {
       switch (cmd)
       {
          case 'a':
-               arg = optarg;
-               tokenize(A);
-               HaveArgs = true;
-               break;
          case 'b':
-               arg = optarg;
-               tokenize(B);
-               HaveArgs = true;
-               break;
          case 'c':
-               arg = optarg;
-               tokenize(C);
+         case 'd':
+         case 'e':
+         case 'f':
+         case 'g':
+               ret = set_tape(cmd - 'a', optarg) && ret;
                HaveArgs = true;
                break;
-         case 'd':
-               arg = optarg;
-               tokenize(D);
+         case 'h':    // tape H, or help if there is no file name
+               if (!optarg && optind < argc && argv[optind][0] != '-')
+                  optarg = argv[optind++];
+               if (optarg)
+               {
+                  ret = set_tape(H, optarg) && ret;
+                  HaveArgs = true;
+               }
+               else
+               {
+                  usage(argv[0]);
+                  ret = false;
+               }
+               break;
+         case 'm':
+               ManifestName = optarg;
                HaveArgs = true;
                break;
          case 'o':
@@ -227,7 +369,25 @@ static bool parse_args(int argc, char *argv[])
                Debug = true;
                cout << "Debug turned on." << endl;
                break;
-         case 'h':
+         case 's':
+               SubSample = true;
+               break;
+         case 'r':
+               Realign = strtol(optarg,nullptr,10);
+               if (Realign < 1)
+               {
+                  cout << "FATAL: -realign needs a number of timing pulses, not " << optarg << endl;
+                  ret = false;
+               }
+               SubSample = true;
+               break;
+         case 'S':
+               if (!optarg && optind < argc && argv[optind][0] != '-')
+                  optarg = argv[optind++];
+               if (optarg)
+                  SmrDate = optarg;
+               ToSmr = true;
+               break;
          case '?':
          default:
             usage(argv[0]); 
@@ -235,6 +395,13 @@ static bool parse_args(int argc, char *argv[])
             break;
       }
    }
+   if (ret && ManifestName.length())
+      ret = read_manifest();
+   if (SubSample && Debug)
+   {
+      cout << "FATAL: -D traces the raw blocks, it can not be used with -subsample or -realign." << endl;
+      ret = false;
+   }
    if (HaveArgs && OutName.length() == 0)
    {
       cout << "FATAL: If using command line arguments, the output name is required." << endl;
@@ -250,14 +417,28 @@ static void read_headers()
 {
    for (int idx = 0; idx < MAX_TAPES; ++idx)
    {
-      if (Files[idx].fstrm.is_open())
+      if (Files[idx].tape.is_open())
       {
-         Files[idx].fstrm.read(reinterpret_cast<char*>(&Files[idx].header),sizeof(OneFile::header));
-         Files[idx].fstrm.seekg(0);
+         Files[idx].tape.read(reinterpret_cast<char*>(&Files[idx].header),sizeof(OneFile::header));
+         Files[idx].tape.seek(0);
       }
    }
 }
 
+// "YYYY-MM-DD hh:mm:ss" from a tape header's bcd date and time, as print_cygdate shows it
+static string header_date(const cygheader& header)
+{
+   const char* date = header.bcd_date;
+   const char* time = header.bcd_time;
+   char text[64];
+
+   snprintf(text, sizeof(text), "%s%d%d-%d%d-%d%d %d%d:%d%d:%d%d",
+            date[1] * 10 + date[0] > 19 ? "19" : "20",  // only 2 digits of year
+            date[1], date[0], date[5], date[4], date[3], date[2],
+            time[5], time[4], time[3], time[2], time[1], time[0]);
+   return text;
+}
+
 
 /* For each open file, skip header then look at timing channel for each file.
    Examining a couple of recordings, the values on the timing pulse channel
@@ -277,96 +458,59 @@ static void read_headers()
 static void sync_timings()
 {
    int file;
-   bool found, find_peak;
    int chan;
-   off_t seq_pos = 0;
-   unsigned char sample_l, sample_h;
-   short sample, max_sample;
-   off_t curr_start = 0;
-   InBuff inbuff;
-   InBuffIter iter;
- 
-     // There is a header from the tape and a pad
-     // of zero that ddrescue adds to form 1 tape sector. Skip this.
-   for (file=0; file < MAX_TAPES; ++file)
-      if (Files[file].fstrm.is_open())
-         Files[file].fstrm.seekg(CYG_BUFF_SIZ);
+   PulseList hits;
+   PulseIndex index;
+   const off_t first = CYG_BUFF_SIZ / CYG_CHAN_BLOCK;
 
    for (file=0; file < MAX_TAPES; ++file)
    {
-      if (!Files[file].fstrm.is_open())
+      if (!Files[file].tape.is_open())
          continue;
-      found = find_peak = false;
+      if (Files[file].sync_chan < 1 || Files[file].sync_chan > CYG_CHANS)
+      {
+         cout << "FATAL: Timing pulse channel for " << Files[file].name << " must be 1 to " << CYG_CHANS
+              << ", not " << Files[file].sync_chan << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
       chan = rev_cmap[Files[file].sync_chan]-1;
-      cout << "Searching for timing pulse in " << Files[file].name << endl;
       if (Debug) cout << "clock chan: " <<  Files[file].sync_chan << "  index in stream: " << chan << endl;
-      max_sample = 0;
-      off_t blk = 0;
-      while(!found)
+        // There is a header from the tape and a pad
+        // of zero that ddrescue adds to form 1 tape sector. Skip this.
+      hits.clear();
+      bool have = index.load(Files[file].name, Files[file].sync_chan, first);
+      if (have)
+         cout << "Using timing pulses saved in " << index.name() << endl;
+      else if (Realign)  // needs them all, save them for next time
       {
-         blk = (Files[file].fstrm.tellg()) / CYG_CHAN_BLOCK;
-         Files[file].fstrm.read(reinterpret_cast<char *>(inbuff.data()),CYG_CHAN_BLOCK);
-         if (Files[file].fstrm.eof())  // missing marker?
-         {
-            cout << "File " << Files[file].name << " appears to not have a timing pulse or the channel number is wrong." << endl;
-            cout << "Unable to proceed." <<endl;
-            cout << "Exiting program. . ." << endl;
-            exit(1);
-         }
-         iter = inbuff.begin();
-         iter += chan*2;
-         sample_l = *iter++;
-         sample_h = *iter;
-         sample = sample_l + 256 * sample_h;
-         
-         if (false)   // debug
-         {
-            if (sample < 0)
-               cout << blk << ":  " << sample << endl << flush;
-            else if (sample > 0)
-               cout << "  " << blk << ": ++++ " << sample << endl << flush;
-         }
-         if (find_peak)  // are in pulse, find max
-         {
-            if (max_sample < sample)
-               max_sample = sample;
-            else if (max_sample > sample)
-            {
-               //blk -= 1;                 // went one sample too far
-               Files[file].peak = blk;  // peak in this sample blk #
-               Files[file].fstrm.seekg(0);
-               found = true;
-               cout << "Found peak for " << Files[file].name << " at sample block " << blk << endl;
-            }
-         }
-         else if (sample <= 0)
-         {
-            curr_start = seq_pos = 0;
-         }
-         else if (sample > 0 && curr_start == 0)
-         {
-            curr_start = Files[file].fstrm.tellg() - CYG_CHAN_BLOCK;
-            seq_pos = 0;
-            max_sample = sample;
-         }
-         else if (sample > 0 && sample > max_sample) // rising signal
-         {
-            max_sample = sample;
-            ++seq_pos;
-            if (seq_pos == 10) // looks like a good pulse, back up, then find peak
-            {
-               find_peak = true;
-               Files[file].fstrm.seekg(curr_start); // back to start of pulse
-               max_sample = 0;
-            }
-         }
-         else if (sample > 0 && sample < max_sample) // falling sig
-         {
-            curr_start = 0;     // if here, we did not find minimum increasing samples
-            max_sample = 0;
-            seq_pos = 0;
-         }
+         cout << "Searching for timing pulses in " << Files[file].name << endl;
+         if (!index.build(Files[file].name, Files[file].sync_chan, chan, first))
+            cout << "Could not save them in " << index.name() << ", continuing." << endl;
+         have = true;
+      }
+      else
+      {
+         cout << "Searching for timing pulse in " << Files[file].name << endl;
+         find_pulses(Files[file].tape, chan, RESTART_AFTER_FALL, first, hits, 1);
+      }
+      if (have)
+      {
+         size_t want = Realign ? index.size(RESTART_AFTER_FALL) : min<size_t>(1, index.size(RESTART_AFTER_FALL));
+         for (size_t idx = 0; idx < want; ++idx)
+            hits.push_back({index.pulses(RESTART_AFTER_FALL)[idx].top, index.pulses(RESTART_AFTER_FALL)[idx].fall});
+         index.close();
       }
+      if (hits.empty())  // missing marker?
+      {
+         cout << "File " << Files[file].name << " appears to not have a timing pulse or the channel number is wrong." << endl;
+         cout << "Unable to proceed." <<endl;
+         cout << "Exiting program. . ." << endl;
+         exit(1);
+      }
+      Files[file].peak = hits[0].fall;  // peak in this sample blk #
+      Files[file].pulses = hits;
+      Files[file].tape.seek(0);
+      cout << "Found peak for " << Files[file].name << " at sample block " << Files[file].peak << endl;
    }
 }
 
@@ -390,24 +534,412 @@ static void align_chans()
    int file;
 
    for (file=0; file < MAX_TAPES; ++file)  // find minimum peak offset
-      if (Files[file].fstrm.is_open())
+      if (Files[file].tape.is_open())
          if (Files[file].peak < peak_off)
             peak_off = Files[file].peak;
 
    for (file=0; file < MAX_TAPES; ++file)  // find minimum peak offset
-      if (Files[file].fstrm.is_open())
+      if (Files[file].tape.is_open())
          diffs[file] = (Files[file].peak - peak_off) * CYG_CHAN_BLOCK;
 
      // skip first block
    for (file=0; file < MAX_TAPES; ++file)
-      if (Files[file].fstrm.is_open())
-         Files[file].fstrm.seekg(CYG_BUFF_SIZ);
+      if (Files[file].tape.is_open())
+         Files[file].tape.seek(CYG_BUFF_SIZ);
 
    for (file=0; file < MAX_TAPES; ++file)
-      if (Files[file].fstrm.is_open())
-         Files[file].fstrm.seekg(diffs[file], ios_base::cur);
+      if (Files[file].tape.is_open())
+         Files[file].tape.skip(diffs[file]);
+}
+
+
+/* -subsample. align_chans lined the tapes up on whole blocks. The tape
+   whose pulse comes first, which align_chans did not move, is the
+   reference. Every other tape's first pulse, and with -realign every Nth
+   after that, is cross-correlated with the reference tape's to get the
+   offset to a fraction of a block. Each tape is moved back whole blocks so
+   it has a delay of 0 to 1 block at the first pulse, and the decoder
+   interpolates between samples to apply it.
+*/
+static void plan_delays()
+{
+   int ref = -1;
+   int file;
+   const off_t first = CYG_BUFF_SIZ / CYG_CHAN_BLOCK;
+
+   for (file = 0; file < MAX_TAPES; ++file)
+      if (Files[file].tape.is_open() && (ref < 0 || Files[file].peak < Files[ref].peak))
+         ref = file;
+   const OneFile& rf = Files[ref];
+   const off_t ref_start = rf.tape.tell() / CYG_CHAN_BLOCK;
+   const size_t step = Realign ? Realign : rf.pulses.size();
+   cout << "Sub-sample alignment against " << rf.name << endl;
+
+   for (file = 0; file < MAX_TAPES; ++file)
+   {
+      if (!Files[file].tape.is_open() || file == ref)
+         continue;
+      OneFile& xf = Files[file];
+      off_t start = xf.tape.tell() / CYG_CHAN_BLOCK;
+      double offset = start - ref_start;   // best guess so far
+      size_t xk = 0;
+      int missed = 0;
+
+      for (size_t k = 0; k < rf.pulses.size(); k += step)
+      {
+         off_t ref_top = rf.pulses[k].top;
+         double expect = ref_top + offset;
+         while (xk + 1 < xf.pulses.size() && fabs(xf.pulses[xk+1].top - expect) <= fabs(xf.pulses[xk].top - expect))
+            ++xk;
+         double found;
+         if (xk >= xf.pulses.size() || fabs(xf.pulses[xk].top - expect) > PULSE_MATCH_SLOP
+             || !pulse_offset(rf.tape, rev_cmap[rf.sync_chan]-1, ref_top,
+                              xf.tape, rev_cmap[xf.sync_chan]-1, xf.pulses[xk].top, found))
+         {
+            ++missed;
+            continue;
+         }
+         offset = found;
+         xf.plan.at.push_back(ref_top - ref_start);
+         xf.plan.delay.push_back(offset - (start - ref_start));
+      }
+      if (xf.plan.empty())
+      {
+         cout << "Could not line up " << xf.name << " to a fraction of a sample, whole samples are used." << endl;
+         continue;
+      }
+      if (missed)
+         cout << "Skipped " << missed << " alignment checks on " << xf.name << " with no matching pulse." << endl;
+
+      off_t shift = floor(xf.plan.delay[0]);
+      if (start + shift < first)
+         shift = first - start;
+      xf.tape.seek((start + shift) * CYG_CHAN_BLOCK);
+      for (auto& delay : xf.plan.delay)
+         delay -= shift;
+      cout << fixed << setprecision(3)
+           << xf.name << " is " << (start - ref_start) + shift + xf.plan.delay.front() << " blocks after " << rf.name;
+      if (xf.plan.delay.size() > 1)
+         cout << " at the first check, " << (start - ref_start) + shift + xf.plan.delay.back() << " at the last of "
+              << xf.plan.delay.size();
+      cout << endl;
+      cout.unsetf(ios::floatfield);
+   }
+}
+
+
+/* Put one sample block from a tape in chan order, as daq offset binary.
+   0 is not a legal daq value, it becomes 1, the next most negative.
+   cyg2cyg25KHz fills dropouts with -32768, which ends up as 1 here as
+   well, its <output>.repairs.tsv says where they are. -smr does not come
+   through here, it keeps -32768.
+*/
+static void convert_block_scalar(const char* in, unsigned short* out)
+{
+   const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in);
+   unsigned short sample;
+
+   for (int chan = 0; chan < CYG_CHANS; ++chan)
+   {
+      sample = bytes[chan*2] + 256 * bytes[chan*2+1];
+      sample += 0x8000;
+      if (sample == 0)
+         sample = 1;
+      out[cmap[chan+1]-1] = sample;
+   }
 }
 
+// Same, but the samples are left signed as they are on the tape, for -smr
+static void decode_block_scalar(const char* in, short* out)
+{
+   const unsigned char* bytes = reinterpret_cast<const unsigned char*>(in);
+
+   for (int chan = 0; chan < CYG_CHANS; ++chan)
+      out[cmap[chan+1]-1] = bytes[chan*2] + 256 * bytes[chan*2+1];
+}
+
+#ifdef HAVE_X86_SIMD
+// Two shuffles per output half put 8 chans in order
+__attribute__((target("ssse3")))
+static inline __m128i shuffle_half(__m128i lo, __m128i hi, int half)
+{
+   __m128i mask_lo = _mm_load_si128(reinterpret_cast<const __m128i*>(shufMask[half][0].data()));
+   __m128i mask_hi = _mm_load_si128(reinterpret_cast<const __m128i*>(shufMask[half][1].data()));
+   return _mm_or_si128(_mm_shuffle_epi8(lo, mask_lo), _mm_shuffle_epi8(hi, mask_hi));
+}
+
+// convert_block_scalar, shuffle, then bias and clamp.
+__attribute__((target("ssse3")))
+static void convert_block_ssse3(const char* in, unsigned short* out)
+{
+   const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+   const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16));
+   const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+   const __m128i zero = _mm_setzero_si128();
+
+   for (int half = 0; half < 2; ++half)
+   {
+      __m128i val = shuffle_half(lo, hi, half);
+      val = _mm_add_epi16(val, bias);
+      val = _mm_sub_epi16(val, _mm_cmpeq_epi16(val, zero));  // 0 - (-1) = 1
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + half*8), val);
+   }
+}
+
+// decode_block_scalar, the shuffles only
+__attribute__((target("ssse3")))
+static void decode_block_ssse3(const char* in, short* out)
+{
+   const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+   const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16));
+
+   for (int half = 0; half < 2; ++half)
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + half*8), shuffle_half(lo, hi, half));
+}
+#endif
+
+static void (*convert_block)(const char*, unsigned short*) = convert_block_scalar;
+static void (*decode_block)(const char*, short*) = decode_block_scalar;
+
+static void pick_convert()
+{
+#ifdef HAVE_X86_SIMD
+   if (__builtin_cpu_supports("ssse3"))
+   {
+      convert_block = convert_block_ssse3;
+      decode_block = decode_block_ssse3;
+   }
+#endif
+}
+
+/* The record loop and decoders work in either kind of sample: unsigned
+   short offset binary for .daq files, short for -smr. These pick the
+   conversion, the zero value and the sub-sample blend for each.
+*/
+static void to_samples(const char* in, unsigned short* out) {convert_block(in, out);}
+static void to_samples(const char* in, short* out) {decode_block(in, out);}
+
+template <typename Sample> constexpr Sample zero_sample();
+template <> constexpr unsigned short zero_sample<unsigned short>() {return 0x8000;}
+template <> constexpr short zero_sample<short>() {return 0;}
+
+// left and right weighted in 1/65536ths, rounded
+static unsigned short blend(unsigned short left, unsigned short right, unsigned weight)
+{
+   return (left * (65536 - weight) + right * weight + 32768) >> 16;
+}
+
+static short blend(short left, short right, unsigned weight)
+{
+   int wt = weight;
+   return (left * (65536 - wt) + right * wt + 32768) >> 16;
+}
+
+
+// The -D trace of the timing chans of tapes B and C
+static void debug_block(const InBuff& inbuff, int file, off_t blk, short& maxb, short& maxc)
+{
+   const unsigned char* bytes = reinterpret_cast<const unsigned char*>(inbuff.data());
+   short sample;
+
+   for (int chan = 0; chan < CYG_CHANS; ++chan)
+   {
+      sample = bytes[chan*2] + 256 * bytes[chan*2+1];
+      if (file == 1 && cmap[chan+1] == 16)
+      {
+         if (sample < 0)
+            cout << "B: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
+         else
+            cout << "  +++ B: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
+         if (sample > maxb)
+         {
+            maxb = sample;
+            cout << "B MAX: " << maxb  << endl;
+         }
+      }
+      else if (file == 2 && cmap[chan+1] == 16)
+      {
+         if (sample < 0)
+            cout << "C: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
+         else
+            cout << "  +++ C: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
+         if (sample > maxc)
+         {
+            maxc = sample;
+            cout << "C MAX: " << maxc << endl;
+         }
+      }
+      cout << "file index: " << chan << " lookup: " << cmap[chan+1] + file * CYG_CHANS << endl;
+   }
+}
+
+
+/* A batch of sample blocks from one tape, already in chan order and
+   offset binary, or signed for -smr. The last batch from a tape has the
+   bytes of the short read at the end, 0 to 31 of them, in tailRaw.
+*/
+template <typename Sample>
+struct FrameBatch
+{
+   array<Sample,BATCH_FRAMES*CYG_CHANS> data;
+   int frames = 0;
+   int tail = -1;     // -1 if this is not the end of the tape
+   InBuff tailRaw;
+};
+
+/* Decodes one tape on its own thread into a ring of batches. The record
+   loop takes the blocks out in order with next(). With a delay plan each
+   block is interpolated from the two tape blocks around where it falls.
+*/
+template <typename Sample>
+class TapeDecoder
+{
+   public:
+      TapeDecoder(TapeReader& from, const DelayPlan& delays) : tape(from), start(from.tell()), plan(delays)
+      {
+         if (plan.empty())
+            worker = thread(&TapeDecoder::run, this);
+         else
+            worker = thread(&TapeDecoder::run_delayed, this);
+      }
+      ~TapeDecoder() {worker.join();}
+
+        // Copy the next block to dest. False at the short read at the end
+        // of the tape, tail() has the bytes that were read.
+      bool next(Sample* dest)
+      {
+         while (true)
+         {
+            if (!current)
+            {
+               current = ring->front_wait();
+               used = 0;
+            }
+            if (used < current->frames)
+            {
+               memcpy(dest, current->data.data() + used * CYG_CHANS, CYG_CHAN_BLOCK);
+               ++used;
+               ++taken;
+               return true;
+            }
+            if (current->tail >= 0)
+            {
+               atEof = true;
+               return false;
+            }
+            ring->pop();
+            current = nullptr;
+         }
+      }
+      bool eof() const {return atEof;}
+      const FrameBatch<Sample>& last() const {return *current;}
+      off_t last_offset() const {return start + (taken - 1) * CYG_CHAN_BLOCK;}
+
+   private:
+      void run()
+      {
+         vector<char> raw(BATCH_FRAMES * CYG_CHAN_BLOCK);
+         FrameBatch<Sample>* batch;
+         do
+         {
+            batch = ring->claim_wait();
+            size_t got = tape.read(raw.data(), raw.size());
+            batch->frames = got / CYG_CHAN_BLOCK;
+            for (int frame = 0; frame < batch->frames; ++frame)
+               to_samples(raw.data() + frame * CYG_CHAN_BLOCK, batch->data.data() + frame * CYG_CHANS);
+            batch->tail = got < raw.size() ? got % CYG_CHAN_BLOCK : -1;
+            if (batch->tail > 0)
+               memcpy(batch->tailRaw.data(), raw.data() + batch->frames * CYG_CHAN_BLOCK, batch->tail);
+            ring->publish();
+         } while (batch->tail < 0);
+      }
+
+        // Output block n is tape block n + delay, weighted between the two
+        // blocks it falls between in 1/65536ths.
+      void run_delayed()
+      {
+         vector<char> raw(BATCH_FRAMES * CYG_CHAN_BLOCK);
+         vector<Sample> conv;   // decoded tape blocks from conv_first on
+         off_t conv_first = 0;
+         off_t out = 0;
+         size_t hint = 0;
+         bool end = false;
+         int tail = 0;
+         InBuff tail_raw;
+         FrameBatch<Sample>* batch = ring->claim_wait();
+         batch->frames = 0;
+
+         while (true)
+         {
+            if (!end)
+            {
+               size_t got = tape.read(raw.data(), raw.size());
+               int frames = got / CYG_CHAN_BLOCK;
+               size_t have = conv.size();
+               conv.resize(have + frames * CYG_CHANS);
+               for (int frame = 0; frame < frames; ++frame)
+                  to_samples(raw.data() + frame * CYG_CHAN_BLOCK, conv.data() + have + frame * CYG_CHANS);
+               if (got < raw.size())
+               {
+                  end = true;
+                  tail = got % CYG_CHAN_BLOCK;
+                  memcpy(tail_raw.data(), raw.data() + frames * CYG_CHAN_BLOCK, tail);
+               }
+            }
+            off_t conv_end = conv_first + conv.size() / CYG_CHANS;
+            off_t blk = 0;
+            while (true)
+            {
+               double pos = out + plan.value(out, hint);
+               blk = floor(pos);
+               unsigned weight = lround((pos - blk) * 65536);
+               if (blk < 0)
+                  blk = weight = 0;
+               if (weight == 65536)
+               {
+                  ++blk;
+                  weight = 0;
+               }
+               if (blk + (weight ? 1 : 0) >= conv_end)
+                  break;
+               const Sample* left = conv.data() + (blk - conv_first) * CYG_CHANS;
+               const Sample* right = weight ? left + CYG_CHANS : left;
+               Sample* dest = batch->data.data() + batch->frames * CYG_CHANS;
+               for (int chan = 0; chan < CYG_CHANS; ++chan)
+                  dest[chan] = blend(left[chan], right[chan], weight);
+               ++out;
+               if (++batch->frames == BATCH_FRAMES)
+               {
+                  batch->tail = -1;
+                  ring->publish();
+                  batch = ring->claim_wait();
+                  batch->frames = 0;
+               }
+            }
+            if (end)
+            {
+               batch->tail = tail;
+               batch->tailRaw = tail_raw;
+               ring->publish();
+               return;
+            }
+              // keep from the block the next output starts at
+            off_t keep = max(min(blk, conv_end), conv_first);
+            conv.erase(conv.begin(), conv.begin() + (keep - conv_first) * CYG_CHANS);
+            conv_first = keep;
+         }
+      }
+      TapeReader& tape;
+      off_t start;
+      const DelayPlan& plan;
+      unique_ptr<SpscRing<FrameBatch<Sample>,RING_BATCHES>> ring{new SpscRing<FrameBatch<Sample>,RING_BATCHES>};
+      FrameBatch<Sample>* current = nullptr;
+      int used = 0;
+      off_t taken = 0;
+      bool atEof = false;
+      thread worker;
+};
+
       
 /* What we are here for.  Read all of the chan files for the current
    section, 1-64 or 65-128 and combine them all back into a .daq file that
@@ -417,58 +949,116 @@ static void align_chans()
    0xffff is max positive, 
    0x8000 is zero.
    0000 is max negative
+   With -smr the records are Sample short, signed as on the tape, and go
+   straight to the .smr chans.
 */
+template <typename Sample>
 static bool create_daq()
 {
-   OutBuff outbuff;
+   array<vector<Sample>,MAX_DAQS> outbuff;
+   array<ofstream,MAX_DAQS> out_file;
+   DaqSmrWriter smr;
+   array<Sample*,MAX_DAQS> outptr;
+   size_t recs = 0;
+   int num_daqs = 1;
    InBuff inbuff;
-   InBuffIter in_iter;
-   unsigned short *outptr;
-   unsigned char sample_l, sample_h;
-   short sample;
    off_t percent = 0;
-   struct stat info;
    unsigned long long feedback = 0, throttle = 0;
-   int chan, index, file, cyg_off;;
+   int file, daq;
    bool read_more;
    short maxb = 0;
    short maxc = 0;
+   array<unique_ptr<TapeDecoder<Sample>>,MAX_TAPES> decoder;
+   int last_file = -1;    // tape of the last block read, -1 if it is in inbuff
+   off_t last_off = 0;
 
-   auto newbuff = [&] {outbuff.fill(0x8000); outbuff[0] = outbuff[1] = 0;};
+   auto newbuff = [&] {for (daq = 0; daq < num_daqs; ++daq)
+                       {
+                          outptr[daq] = outbuff[daq].data() + recs * DAQ_BUFF_SIZ;
+                          fill(outptr[daq], outptr[daq] + DAQ_BUFF_SIZ, zero_sample<Sample>());
+                          outptr[daq][0] = outptr[daq][1] = 0;
+                       }};
 
    for (file = 0; file < MAX_TAPES; ++file)
    {
       if (Files[file].name.length())
       {
-         Files[file].fstrm.open(Files[file].name.c_str(),ios::binary);
-         if (!Files[file].fstrm.is_open())
+         if (!Files[file].tape.open(Files[file].name))
          {
             cout << "FATAL: Could not open " << Files[file].name << endl << "exiting. . ." << endl;
             exit(1);
          }
-          // size of files
-         FILE* fd = fopen(Files[file].name.c_str(),"r");
-         fstat(fileno(fd),&info);
-         percent += info.st_size;  // bytes in all files
-         fclose(fd);
+         percent += Files[file].tape.size();  // bytes in all files
       }
    }
 
-   ofstream out_file(OutName.c_str(),ios::binary);
-   if (!out_file.is_open())
+   for (file = TAPES_PER_DAQ; file < MAX_TAPES; ++file)
+      if (Files[file].tape.is_open())
+         num_daqs = MAX_DAQS;
+   for (daq = 0; daq < num_daqs; ++daq)
    {
-      cout << "FATAL: Could not open output file " << OutName << endl << "Exiting. . ." << endl;
-      exit(1);
+      outbuff[daq].resize(DAQ_BUFF_SIZ * DAQ_WRITE_RECS);
+      if (ToSmr)
+         continue;
+      out_file[daq].open(DaqNames[daq].c_str(),ios::binary);
+      if (!out_file[daq].is_open())
+      {
+         cout << "FATAL: Could not open output file " << DaqNames[daq] << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
    }
+     // with -smr the records go to the smr chans as they are, no offset binary
+   auto writebuff = [&] {if (ToSmr)
+                            smr.add(outbuff[0].data(), num_daqs > 1 ? outbuff[1].data() : nullptr, recs);
+                         else
+                            for (daq = 0; daq < num_daqs; ++daq)
+                               out_file[daq].write(reinterpret_cast<char*>(outbuff[daq].data()),
+                                                   recs * DAQ_BUFF_SIZ * sizeof(short));
+                         recs = 0;};
 
    read_headers();
+   if (ToSmr)
+   {
+      vector<string> comments;
+      string tapes[MAX_DAQS];
+      time_t nowtime = time(nullptr);
+
+      for (file = 0; file < MAX_TAPES; ++file)
+         if (Files[file].tape.is_open())
+         {
+            if (SmrDate.empty())
+               SmrDate = header_date(Files[file].header);
+            tapes[file / TAPES_PER_DAQ] += string(tapes[file / TAPES_PER_DAQ].empty() ? "" : " ") + Files[file].name;
+         }
+      cout << "Date/time stamp: " << SmrDate << endl;
+      comments.push_back("Cygnus tape conversion to smr format.");
+      comments.push_back(tapes[0].empty() ? "" : "Tapes A-D: " + tapes[0]);
+      comments.push_back(tapes[1].empty() ? "" : "Tapes E-H: " + tapes[1]);
+      comments.push_back(string("On ") + ctime(&nowtime));
+      if (!smr.create(SmrName, num_daqs * CHANS_PER_FILE, SmrDate, comments))
+      {
+         cout << "FATAL: Could not create " << SmrName << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+   }
    sync_timings();
    align_chans();
+   if (SubSample)
+      plan_delays();
    for (file=0; file < MAX_TAPES; ++file)
-      if (Files[file].fstrm.is_open())
-         cout << "Starting file position for " << file << ": " << Files[file].fstrm.tellg() - (off_t) CYG_BUFF_SIZ << endl;
+      if (Files[file].tape.is_open())
+         cout << "Starting file position for " << file << ": " << Files[file].tape.tell() - (off_t) CYG_BUFF_SIZ << endl;
 
 
+     // a thread per tape decodes blocks, this thread puts them in records.
+     // Debug reads here one block at a time so the trace is in order.
+   inbuff.fill(0);
+   if (!Debug)
+      for (file = 0; file < MAX_TAPES; ++file)
+         if (Files[file].tape.is_open())
+            decoder[file].reset(new TapeDecoder<Sample>(Files[file].tape, Files[file].plan));
+   auto at_eof = [&](int idx) {return decoder[idx] ? decoder[idx]->eof() : Files[idx].tape.eof();};
+
    off_t blk = 0;
    while (true)
    {
@@ -476,7 +1066,7 @@ static bool create_daq()
       read_more = false;
       for (int eofchk = 0; eofchk < MAX_TAPES; ++eofchk)
       {
-          if (Files[eofchk].fstrm.is_open() && !Files[eofchk].fstrm.eof())
+          if (Files[eofchk].tape.is_open() && !at_eof(eofchk))
           {
              read_more = true;
              break;
@@ -485,64 +1075,43 @@ static bool create_daq()
       if (!read_more)
          break;
 
-      cyg_off = 0;
       newbuff();
-      outptr = outbuff.data() + 2; // skip markers
       ++blk;
-      for (file = 0; file < MAX_TAPES; ++file, cyg_off += CYG_CHANS)
+      for (file = 0; file < MAX_TAPES; ++file)
       {
-         if (!Files[file].fstrm.is_open() || Files[file].fstrm.eof())
+         if (!Files[file].tape.is_open() || at_eof(file))
             continue;
-         Files[file].fstrm.read(reinterpret_cast<char *>(inbuff.data()),CYG_CHAN_BLOCK);
-         in_iter = inbuff.begin();
+           // skip markers, then 16 chans per tape
+         Sample* dest = outptr[file / TAPES_PER_DAQ] + 2 + (file % TAPES_PER_DAQ) * CYG_CHANS;
          feedback += CYG_CHAN_BLOCK;
          ++throttle;
-         while (in_iter != inbuff.end())
+         if (!decoder[file])
          {
-            for (chan = 0; chan < CYG_CHANS; ++chan)
-            {
-               sample_l = *in_iter++;
-               sample_h = *in_iter++;
-               sample = sample_l + 256 * sample_h;
-
-               if (Debug)
-               {
-                  if (file == 1 && cmap[chan+1] == 16)
-                  {
-                     if (sample < 0)
-                        cout << "B: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
-                     else
-                        cout << "  +++ B: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
-                     if (sample > maxb)
-                     {
-                        maxb = sample;
-                        cout << "B MAX: " << maxb  << endl;
-                     }
-                  }
-                  else if (file == 2 && cmap[chan+1] == 16)
-                  {
-                     if (sample < 0)
-                        cout << "C: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
-                     else
-                        cout << "  +++ C: file: " << file << " blk: " << blk << ":  " << sample << endl << flush;
-                     if (sample > maxc)
-                     {
-                        maxc = sample;
-                        cout << "C MAX: " << maxc << endl;
-                     }
-                  }
-               }
-
-               sample += 0x8000;
-               if (sample == 0)  // illegal value, most negative value
-                  sample =  1;   // make it the next most negative value
-               index = cmap[chan+1] + cyg_off;
-               if (Debug) cout << "file index: " << chan << " lookup: " << index << endl;
-               *(outptr + index-1) = sample;
-            }
+            Files[file].tape.read(reinterpret_cast<char *>(inbuff.data()),CYG_CHAN_BLOCK);
+            if (Debug)
+               debug_block(inbuff, file, blk, maxb, maxc);
+            to_samples(inbuff.data(), dest);
+         }
+         else if (decoder[file]->next(dest))
+         {
+            last_file = file;
+            last_off = decoder[file]->last_offset();
+         }
+         else
+         {
+              // The short read at the end of a tape. One block buffer used
+              // to be shared by all the tapes, the bytes past the end of
+              // this one are left from the last block read from any tape.
+            if (last_file >= 0)
+               Files[last_file].tape.read_at(last_off, inbuff.data(), CYG_CHAN_BLOCK);
+            const FrameBatch<Sample>& end = decoder[file]->last();
+            memcpy(inbuff.data(), end.tailRaw.data(), end.tail);
+            to_samples(inbuff.data(), dest);
+            last_file = -1;
          }
       }
-      out_file.write(reinterpret_cast<char*>(outbuff.data()),sizeof(outbuff));
+      if (++recs == DAQ_WRITE_RECS)
+         writebuff();
       if (throttle > 1024)
       {
          printf("\r  %3.0f%%",((double)feedback/percent)*100.0);
@@ -550,10 +1119,24 @@ static bool create_daq()
          throttle = 0;
       }
    }
+   writebuff();
+   for (auto& dec : decoder)
+      dec.reset();
+   if (ToSmr)
+      smr.close();
+   for (daq = 0; daq < num_daqs && !ToSmr; ++daq)
+   {
+      out_file[daq].close();
+      if (out_file[daq].fail())
+      {
+         cout << endl << "FATAL: Error writing " << DaqNames[daq] << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+   }
    cout << endl;
    for (file = 0; file < MAX_TAPES; ++file)
-      if (Files[file].fstrm.is_open())
-         Files[file].fstrm.close();
+      if (Files[file].tape.is_open())
+         Files[file].tape.close();
    return true;
 }
 
@@ -584,15 +1167,7 @@ static void get_in(const string& prompt1, const string& prompt2, int f_idx)
    }
 }
 
-const string a_prompt1("Enter cygnus tape A input filename, ENTER for none: ");
-const string a_prompt2("Enter cygnus tape A Timing Pulse channel: ");
-const string b_prompt1("Enter cygnus tape B input filename, ENTER for none: ");
-const string b_prompt2("Enter cygnus tape B Timing Pulse channel: ");
-const string c_prompt1("Enter cygnus tape C input filename, ENTER for none: ");
-const string c_prompt2("Enter cygnus tape C Timing Pulse channel: ");
-const string d_prompt1("Enter cygnus tape D input filename, ENTER for none: ");
-const string d_prompt2("Enter cygnus tape D Timing Pulse channel: ");
-const string units("ABCD");
+const string units("ABCDEFGH");
 
 int main (int argc, char **argv)
 {
@@ -605,10 +1180,14 @@ int main (int argc, char **argv)
 
    if (!HaveArgs)
    {
-      get_in(a_prompt1, a_prompt2, 0);
-      get_in(b_prompt1, b_prompt2, 1);
-      get_in(c_prompt1, c_prompt2, 2);
-      get_in(d_prompt1, d_prompt2, 3);
+        // always ask for A-D, then E-H until one is left empty
+      for (int file = 0; file < MAX_TAPES; ++file)
+      {
+         if (file >= TAPES_PER_DAQ && Files[file-1].name.empty())
+            break;
+         get_in(string("Enter cygnus tape ") + units[file] + " input filename, ENTER for none: ",
+                string("Enter cygnus tape ") + units[file] + " Timing Pulse channel: ", file);
+      }
       cout << "Enter output file name without .daq extension: " ;
       cin >> OutName;
    }
@@ -616,11 +1195,25 @@ int main (int argc, char **argv)
       if (Files[file].name.length())
          cout << units[file] << ": " << Files[file].name 
               << " sync chan: " << Files[file].sync_chan << endl;
-      else
+      else if (file < TAPES_PER_DAQ)
          cout << units[file] << ": No file" << endl;
-   OutName = OutName + OutTag + "1-64" + DAQ_EXT;
-   cout << "Output file: " << OutName << endl;
-   complain = !create_daq();
+   for (int daq = 0; daq < MAX_DAQS; ++daq)
+      DaqNames[daq] = OutName + OutTag + DaqTags[daq] + DAQ_EXT;
+   SmrName = OutName + SMR_EXT;
+   if (ToSmr)
+      cout << "Output file: " << SmrName << endl;
+   else
+   {
+      cout << "Output file: " << DaqNames[0] << endl;
+      for (int file = TAPES_PER_DAQ; file < MAX_TAPES; ++file)
+         if (Files[file].name.length())
+         {
+            cout << "Output file: " << DaqNames[1] << endl;
+            break;
+         }
+   }
+   pick_convert();
+   complain = ToSmr ? !create_daq<short>() : !create_daq<unsigned short>();
    if (complain)
       usage(argv[0]);
 
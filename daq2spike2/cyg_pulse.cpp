@@ -0,0 +1,417 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Timing pulse finder, see cyg_pulse.h */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+
+#include "cyg_pulse.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+
+// Number of leading blocks whose timing sample is not positive.
+size_t PulseScanner::skip_idle(const char* blocks, size_t count) const
+{
+   size_t blk = 0;
+
+#if defined(__SSE2__)
+     // The timing sample is in the low or high 16 bytes of each block. Take
+     // the max of that half over 8 blocks, one compare says if any is > 0.
+   const char* half = blocks + (word / 8) * 16;
+   int lane_bits = 3 << (2 * (word % 8));
+   const __m128i zero = _mm_setzero_si128();
+   for ( ; blk + 8 <= count; blk += 8)
+   {
+      const char* at = half + blk * PULSE_BLOCK_SIZ;
+      __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(at));
+      for (int k = 1; k < 8; ++k)
+         hi = _mm_max_epi16(hi, _mm_loadu_si128(reinterpret_cast<const __m128i*>(at + k * PULSE_BLOCK_SIZ)));
+      if (_mm_movemask_epi8(_mm_cmpgt_epi16(hi, zero)) & lane_bits)
+         break;
+   }
+#endif
+   for ( ; blk < count; ++blk)
+   {
+      short sample;
+      memcpy(&sample, blocks + blk * PULSE_BLOCK_SIZ + word * 2, sizeof(sample));
+      if (sample > 0)
+         break;
+   }
+   return blk;
+}
+
+
+// The run stopped rising, start over as the rule says.
+void PulseScanner::fall(short sample, off_t blk)
+{
+   rises = 0;
+   if (rule == RESTART_AT_FALL && sample > 0)
+   {
+      state = RISING;
+      peak = sample;
+      top = blk;
+   }
+   else
+      state = IDLE;
+}
+
+
+size_t PulseScanner::scan(const char* blocks, size_t count, off_t first, PulseList& hits, size_t want)
+{
+   size_t idx = 0;
+
+   while (idx < count && hits.size() < want)
+   {
+      if (state == IDLE)
+      {
+         idx += skip_idle(blocks + idx * PULSE_BLOCK_SIZ, count - idx);
+         if (idx == count)
+            break;
+      }
+      short sample;
+      off_t blk = first + idx;
+      memcpy(&sample, blocks + idx * PULSE_BLOCK_SIZ + word * 2, sizeof(sample));
+      ++idx;
+
+      if (state == PEAK)  // in a pulse, find the max
+      {
+         if (peak < sample)
+         {
+            peak = sample;
+            top = blk;
+         }
+         else if (peak > sample)
+         {
+            hits.push_back({top, blk});
+            fall(sample, blk);
+         }
+      }
+      else if (sample <= 0)
+      {
+         state = IDLE;
+         rises = 0;
+      }
+      else if (state == IDLE)  // first positive, a run may be starting
+      {
+         state = RISING;
+         rises = 0;
+         peak = sample;
+         top = blk;
+      }
+      else if (sample > peak)  // rising signal
+      {
+         peak = sample;
+         if (++rises == PULSE_MIN_RISE)
+            state = PEAK;
+      }
+      else if (sample < peak)
+         fall(sample, blk);
+   }
+   return idx;
+}
+
+
+void find_pulses(TapeReader& tape, int word, PULSE_RULE rule, off_t from, PulseList& hits, size_t want)
+{
+   PulseScanner scanner(word, rule);
+   vector<char> buff(TAPE_BUFF_SIZ);
+   const size_t per_read = TAPE_BUFF_SIZ / PULSE_BLOCK_SIZ;
+   off_t blk = from;
+
+   tape.seek(from * PULSE_BLOCK_SIZ);
+   while (hits.size() < want)
+   {
+      size_t got = tape.read(buff.data(), per_read * PULSE_BLOCK_SIZ) / PULSE_BLOCK_SIZ;
+      size_t used = scanner.scan(buff.data(), got, blk, hits, want);
+      blk += used;
+      if (got < per_read)
+         break;
+   }
+   tape.seek(blk * PULSE_BLOCK_SIZ);
+}
+
+
+// The timing chan for blocks first to first + count - 1, less its mean
+static bool pulse_window(const TapeReader& tape, int word, off_t first, int count, vector<double>& vals)
+{
+   vector<char> raw(count * PULSE_BLOCK_SIZ);
+   double mean = 0;
+
+   if (first < 0 || tape.read_at(first * PULSE_BLOCK_SIZ, raw.data(), raw.size()) != raw.size())
+      return false;
+   vals.resize(count);
+   for (int idx = 0; idx < count; ++idx)
+   {
+      short sample;
+      memcpy(&sample, raw.data() + idx * PULSE_BLOCK_SIZ + word * 2, sizeof(sample));
+      vals[idx] = sample;
+      mean += sample;
+   }
+   mean /= count;
+   for (auto& val : vals)
+      val -= mean;
+   return true;
+}
+
+
+bool pulse_offset(const TapeReader& ref, int refWord, off_t refTop,
+                  const TapeReader& x, int xWord, off_t xTop, double& offset)
+{
+   const int width = 2 * PULSE_XCORR_HALF + 1;
+   const int lags = 2 * PULSE_XCORR_LAGS + 1;
+   vector<double> rvals, xvals;
+   double corr[lags];
+   int best = 0;
+
+   if (!pulse_window(ref, refWord, refTop - PULSE_XCORR_HALF, width, rvals)
+       || !pulse_window(x, xWord, xTop - PULSE_XCORR_HALF - PULSE_XCORR_LAGS, width + 2 * PULSE_XCORR_LAGS, xvals))
+      return false;
+
+     // normalized so a lag that takes in more of the pulse does not win on size
+   for (int lag = 0; lag < lags; ++lag)
+   {
+      double sum = 0, energy = 0;
+      for (int idx = 0; idx < width; ++idx)
+      {
+         sum += rvals[idx] * xvals[idx + lag];
+         energy += xvals[idx + lag] * xvals[idx + lag];
+      }
+      corr[lag] = energy > 0 ? sum / sqrt(energy) : 0;
+      if (corr[lag] > corr[best])
+         best = lag;
+   }
+   if (best == 0 || best == lags - 1)
+      return false;
+
+   double below = corr[best-1], at = corr[best], above = corr[best+1];
+   double bend = below - 2 * at + above;
+   double frac = bend < 0 ? 0.5 * (below - above) / bend : 0;
+   offset = xTop - refTop + best - PULSE_XCORR_LAGS + frac;
+   return true;
+}
+
+
+string pulse_index_name(const string& tape)
+{
+   return tape + CYGP_EXT;
+}
+
+
+/* A fast 64 bit hash of a tape, 8 bytes at a time. Feed a tape through in
+   pieces that are multiples of 8 bytes, except the last, starting with
+   TAPE_HASH_SEED.
+*/
+uint64_t tape_hash(const char* data, size_t len, uint64_t hash)
+{
+   const uint64_t mul = 0x9e3779b97f4a7c15ULL;
+   size_t at = 0;
+
+   for ( ; at + sizeof(uint64_t) <= len; at += sizeof(uint64_t))
+   {
+      uint64_t word;
+      memcpy(&word, data + at, sizeof(word));
+      hash = (hash ^ word) * mul;
+      hash ^= hash >> 29;
+   }
+   for ( ; at < len; ++at)
+   {
+      hash = (hash ^ static_cast<unsigned char>(data[at])) * mul;
+      hash ^= hash >> 29;
+   }
+   return hash;
+}
+
+
+static int64_t mtime_ns(const struct stat& info)
+{
+   return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+
+
+void PulseIndex::close()
+{
+   if (map)
+      munmap(map, mapLen);
+   map = nullptr;
+   mapLen = 0;
+   built.clear();
+   header = CygPulseHeader();
+   for (int rule = 0; rule < PULSE_RULES; ++rule)
+   {
+      recs[rule] = nullptr;
+      count[rule] = 0;
+   }
+}
+
+
+bool PulseIndex::load(const string& tape, int chan, off_t from)
+{
+   struct stat tinfo, info;
+   int fd;
+   void* mem;
+
+   close();
+   indexName = pulse_index_name(tape);
+   if (stat(tape.c_str(), &tinfo) != 0)
+      return false;
+   fd = ::open(indexName.c_str(), O_RDONLY);
+   if (fd < 0)
+      return false;
+   if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(CygPulseHeader))
+   {
+      ::close(fd);
+      return false;
+   }
+   mem = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (mem == MAP_FAILED)
+      return false;
+
+   memcpy(&header, mem, sizeof(header));
+   uint64_t room = (info.st_size - sizeof(CygPulseHeader)) / sizeof(CygPulseRec);
+   bool good = memcmp(header.magic, CYGP_MAGIC, sizeof(CYGP_MAGIC)) == 0
+               && header.version == CYGP_VERSION
+               && header.chan == chan
+               && header.first == from
+               && header.tapeSize == (uint64_t) tinfo.st_size
+               && header.tapeMtime == mtime_ns(tinfo)
+               && header.count[0] <= room && header.count[1] <= room - header.count[0]
+               && (off_t) (sizeof(CygPulseHeader) + (header.count[0] + header.count[1]) * sizeof(CygPulseRec)) == info.st_size;
+   if (!good)
+   {
+      munmap(mem, info.st_size);
+      header = CygPulseHeader();
+      return false;
+   }
+   map = mem;
+   mapLen = info.st_size;
+   recs[0] = reinterpret_cast<const CygPulseRec*>(static_cast<const char*>(map) + sizeof(CygPulseHeader));
+   recs[1] = recs[0] + header.count[0];
+   count[0] = header.count[0];
+   count[1] = header.count[1];
+   return true;
+}
+
+
+/* One pass over the tape hashes all of it and runs a scanner for each rule
+   from block from on. Then the index is written to a temp file that is
+   renamed into place, so a half written index is never seen.
+*/
+bool PulseIndex::build(const string& tape, int chan, int word, off_t from)
+{
+   TapeReader reader;
+   struct stat info;
+   PulseScanner scanners[PULSE_RULES] = {{word, RESTART_AFTER_FALL}, {word, RESTART_AT_FALL}};
+   PulseList hits[PULSE_RULES];
+   vector<char> buff(TAPE_BUFF_SIZ);
+   uint64_t hash = TAPE_HASH_SEED;
+   off_t start = 0;
+   off_t scan_from = from * PULSE_BLOCK_SIZ;
+   size_t got;
+
+   close();
+   indexName = pulse_index_name(tape);
+   if (stat(tape.c_str(), &info) != 0 || !reader.open(tape))
+   {
+      cout << "FATAL ERROR: Could not open " << tape << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   do
+   {
+      got = reader.read(buff.data(), buff.size());
+      hash = tape_hash(buff.data(), got, hash);
+      if (start + (off_t) got > scan_from)
+      {
+         size_t skip = max(scan_from - start, (off_t) 0);
+         for (int rule = 0; rule < PULSE_RULES; ++rule)
+            scanners[rule].scan(buff.data() + skip, (got - skip) / PULSE_BLOCK_SIZ,
+                                (start + skip) / PULSE_BLOCK_SIZ, hits[rule], static_cast<size_t>(-1));
+      }
+      start += got;
+   } while (got == buff.size());
+
+   memcpy(header.magic, CYGP_MAGIC, sizeof(CYGP_MAGIC));
+   header.version = CYGP_VERSION;
+   header.chan = chan;
+   header.tapeSize = info.st_size;
+   header.tapeMtime = mtime_ns(info);
+   header.tapeHash = hash;
+   header.first = from;
+   for (int rule = 0; rule < PULSE_RULES; ++rule)
+   {
+      header.count[rule] = count[rule] = hits[rule].size();
+      for (size_t idx = 0; idx < hits[rule].size(); ++idx)
+      {
+         const PulseHit& hit = hits[rule][idx];
+         CygPulseRec rec = {hit.top, hit.fall, 0, 0};
+         if (idx)
+         {
+            rec.topIntv = hit.top - hits[rule][idx-1].top;
+            rec.fallIntv = hit.fall - hits[rule][idx-1].fall;
+         }
+         built.push_back(rec);
+      }
+   }
+   recs[0] = built.data();
+   recs[1] = built.data() + count[0];
+
+   string tmpName = indexName + ".tmp";
+   int fd = ::open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0)
+      return false;
+   bool good = write(fd, &header, sizeof(header)) == (ssize_t) sizeof(header);
+   size_t len = built.size() * sizeof(CygPulseRec);
+   const char* data = reinterpret_cast<const char*>(built.data());
+   while (good && len)
+   {
+      ssize_t res = write(fd, data, len);
+      if (res < 0 && errno == EINTR)
+         continue;
+      good = res > 0;
+      if (good)
+      {
+         data += res;
+         len -= res;
+      }
+   }
+   good = ::close(fd) == 0 && good;
+   if (good)
+      good = rename(tmpName.c_str(), indexName.c_str()) == 0;
+   if (!good)
+      unlink(tmpName.c_str());
+   return good;
+}
@@ -0,0 +1,188 @@
+#ifndef _CYG_PULSE_H
+#define _CYG_PULSE_H
+
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Timing pulse finder for cygnus tapes, used by cyg2daq and cyg2cyg25KHz.
+
+   The timing channel sits near zero, a little negative, between pulses. A
+   good pulse is a triangle: at least 10 rising positive samples after its
+   first positive one, then a peak, then it falls. A run that falls before
+   the 10th rise is not a pulse, and the search goes on.
+
+   The tools differ in one detail. cyg2daq starts looking for a new run at
+   the next positive sample after a fall, cyg2cyg25KHz takes the falling
+   sample itself as the start of a new run. The rule picks which.
+
+   For each pulse two sample blocks are reported. top is the block the peak
+   value is in, as cyg2cyg25KHz has always used it, and fall is the first
+   block after the peak that is lower, which is the block cyg2daq aligns on.
+   If the 10th rise is the peak, top is where the run started, again as
+   cyg2cyg25KHz has always done.
+
+   Blocks are 16 shorts. Only one of them, the timing chan, is looked at.
+   Stretches where it is not positive and no run is under way, which is most
+   of a tape, are skipped 8 blocks at a time with SSE2.
+
+   A PulseIndex holds every pulse in a tape, for both rules. build() finds
+   them in one pass and saves them next to the tape as <tape>.pulses, load()
+   maps a saved one back in, so a tape is only scanned once. A saved index
+   is used only if the tape's size and modification time, the timing chan
+   and the first block scanned are the ones it was made with.
+
+   pulse_offset() lines up the same pulse on two tapes to a fraction of a
+   sample. It cross-correlates the timing chans over a window around the
+   peaks, for a few whole sample lags, and fits a parabola through the best
+   lag and its neighbors.
+
+   <tape>.pulses, little-endian, no padding:
+      CygPulseHeader
+      CygPulseRec  rec[count[0]]   pulses for RESTART_AFTER_FALL
+      CygPulseRec  rec[count[1]]   pulses for RESTART_AT_FALL
+*/
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "cyg_tape.h"
+
+const int PULSE_MIN_RISE = 10;          // rising samples that make a pulse
+const size_t PULSE_BLOCK_SIZ = 32;      // bytes in one 16 chan sample block
+
+enum PULSE_RULE {RESTART_AFTER_FALL, RESTART_AT_FALL};
+const int PULSE_RULES = 2;
+
+struct PulseHit
+{
+   off_t top;    // sample block of the peak
+   off_t fall;   // first lower sample block after the peak
+};
+
+using PulseList = std::vector<PulseHit>;
+
+class PulseScanner
+{
+   public:
+        // word is the index of the timing chan in a block, 0-15
+      PulseScanner(int word, PULSE_RULE rule) : word(word), rule(rule) {}
+      void reset() {state = IDLE; rises = 0; peak = 0; top = 0;}
+        // Look at count blocks, the first of them block number first. State
+        // is kept between calls so a tape can be fed in any size pieces.
+        // Stops once hits holds want pulses. Returns the blocks used.
+      size_t scan(const char* blocks, size_t count, off_t first, PulseList& hits, size_t want);
+
+   private:
+      enum SCAN_STATE {IDLE, RISING, PEAK};
+      size_t skip_idle(const char* blocks, size_t count) const;
+      void fall(short sample, off_t blk);
+      int word;
+      PULSE_RULE rule;
+      SCAN_STATE state = IDLE;
+      int rises = 0;
+      short peak = 0;   // highest sample so far in this run
+      off_t top = 0;
+};
+
+/* Scan a tape from sample block from to its end, or until want pulses are
+   found. The tape is left positioned where the scan stopped. Only whole
+   sample blocks are looked at.
+*/
+void find_pulses(TapeReader& tape, int word, PULSE_RULE rule, off_t from,
+                 PulseList& hits, size_t want = static_cast<size_t>(-1));
+
+const int PULSE_XCORR_HALF = 32;   // samples compared each side of the peak
+const int PULSE_XCORR_LAGS = 4;    // whole sample lags tried each way
+
+/* Offset of the pulse on tape x with its peak near block xTop from the one
+   on tape ref that peaks at refTop, so x at block t + offset lines up with
+   ref at block t. False if a window runs off a tape or the best lag is at
+   the edge of the ones tried.
+*/
+bool pulse_offset(const TapeReader& ref, int refWord, off_t refTop,
+                  const TapeReader& x, int xWord, off_t xTop, double& offset);
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error ".pulses files are written in host byte order, which must be little-endian"
+#endif
+
+const char CYGP_MAGIC[4] = {'C','Y','G','P'};
+const uint16_t CYGP_VERSION = 1;
+const std::string CYGP_EXT(".pulses");
+const uint64_t TAPE_HASH_SEED = 0xcbf29ce484222325ULL;
+
+struct CygPulseHeader
+{
+   char magic[4];
+   uint16_t version;
+   uint16_t chan;         // timing chan, 1-16
+   uint64_t tapeSize;     // bytes in the tape
+   int64_t tapeMtime;     // tape modification time, ns since the epoch
+   uint64_t tapeHash;     // tape_hash() of the whole tape
+   int64_t first;         // first sample block scanned
+   uint64_t count[PULSE_RULES];
+};
+
+struct CygPulseRec
+{
+   int64_t top;
+   int64_t fall;
+   int32_t topIntv;       // blocks since the previous pulse, 0 for the first
+   int32_t fallIntv;
+};
+
+static_assert(sizeof(CygPulseHeader) == 56, "CygPulseHeader must have no padding");
+static_assert(sizeof(CygPulseRec) == 24, "CygPulseRec must have no padding");
+
+class PulseIndex
+{
+   public:
+      PulseIndex() {}
+      ~PulseIndex() {close();}
+      PulseIndex(const PulseIndex&) = delete;
+      PulseIndex& operator=(const PulseIndex&) = delete;
+        // Map in tape's saved index. False if there is none or it does not
+        // match the tape as it is now.
+      bool load(const std::string& tape, int chan, off_t from);
+        // Scan the whole tape and save the index. The pulses are usable even
+        // if saving fails, which is not fatal, the return says if it worked.
+      bool build(const std::string& tape, int chan, int word, off_t from);
+      void close();
+      size_t size(PULSE_RULE rule) const {return count[rule];}
+      const CygPulseRec* pulses(PULSE_RULE rule) const {return recs[rule];}
+      uint64_t hash() const {return header.tapeHash;}
+      const std::string& name() const {return indexName;}
+
+   private:
+      CygPulseHeader header = {};
+      const CygPulseRec* recs[PULSE_RULES] = {nullptr, nullptr};
+      size_t count[PULSE_RULES] = {0, 0};
+      std::vector<CygPulseRec> built;   // when made here rather than mapped
+      void* map = nullptr;
+      size_t mapLen = 0;
+      std::string indexName;
+};
+
+std::string pulse_index_name(const std::string& tape);
+uint64_t tape_hash(const char* data, size_t len, uint64_t hash);
+
+#endif
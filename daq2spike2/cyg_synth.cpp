@@ -0,0 +1,398 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+/* Synthetic cygnus tapes for checking cyg2cyg25KHz, used by cyg25_sweep.sh
+   and cyg25_gaps.sh.
+
+   -o writes a tape: a zeroed header sector, 1000 quiet sample blocks, then
+   timing pulses on the timing chan with the spacings given by -intervals,
+   used in turn, and a sine of amplitude 8000 for each -tones frequency on
+   the other chans in tape order. -cut takes blocks out, as a tape dropout
+   would.
+
+   -measure reads the upsampled output of such a tape, made with one
+   spacing and no cut, and fits each tone, interval by interval, to the
+   sine it should be at the exact places cyg2cyg25KHz puts its 25 KHz
+   samples. It prints the gain and what is left over, aliasing, images
+   and rounding, in dB of the tone.
+
+   -markers counts the output blocks that are -32768 on every chan, the
+   ones cyg2cyg25KHz fills a dropout with.
+
+   Mod History
+   Sun Oct 18 2026 Created.
+*/
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <math.h>
+
+#include <map>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "cyg_tape.h"
+
+using namespace std;
+
+const int CYG_CHANS = 16;
+const off_t CYG_CHAN_BLOCK = CYG_CHANS * sizeof(short);
+const off_t CYG_HEAD_BLOCKS = TAPE_SECTOR_SIZ / CYG_CHAN_BLOCK;
+const off_t LEAD_IN = 1000;              // quiet blocks before the first pulse
+const int IDEAL_CYG = 4800;
+const double CYG_RATE = 24000.0;
+const double DAQ_RATE_SEC = 1.0 / 25000.0;
+const int DAQ_INTV = 5000;
+const double TONE_AMP = 8000.0;
+const int PULSE_HALF = 19;               // blocks each side of a pulse peak
+const short GAP_MARKER = -32768;
+
+using Frame = array<short,CYG_CHANS>;
+
+// same as cyg2cyg25KHz, the index into a block given chan#, 1 based
+const map<int,int> rev_cmap = {
+   {1, 1}, {2, 9}, {3, 5}, {4, 13}, {5, 2}, {6, 10}, {7, 6}, {8, 14},
+   {9, 3}, {10, 11}, {11, 7}, {12, 15}, {13, 4}, {14, 12}, {15, 8}, {16, 16}
+};
+
+// globals
+string OutName;
+string MeasureName;
+string MarkerName;
+vector<int> Intervals = {4799};
+vector<double> Tones;
+int Pulses = 30;
+int SyncChan = 16;
+off_t CutAt = 0;
+off_t CutLen = 0;
+
+static void usage(char* name)
+{
+   printf (
+"\nUsage: %s -o tape.cyg | -measure output.dd | -markers output.dd\n"\
+"       [-intervals n,n,...] [-pulses n] [-tones Hz,Hz,...] [-chan c] [-cut block,count]\n"\
+"\n"\
+"Make a synthetic cygnus tape, or look at what cyg2cyg25KHz made of one.\n"\
+"-intervals  timing pulse spacings in samples, used in turn, default 4799\n"\
+"-pulses     number of timing pulses, default 30\n"\
+"-tones      up to 15 sine frequencies, one per chan\n"\
+"-chan       timing pulse chan, default 16\n"\
+"-cut        leave out count sample blocks from block on, counted from the\n"\
+"            start of the file\n"\
+"-measure    print the gain and residual of each tone in output.dd. Give the\n"\
+"            same -intervals, one spacing only, -pulses, -tones and -chan\n"\
+"            as when the tape was made.\n"\
+"-markers    print the number of dropout marker blocks in output.dd\n"\
+"\n"\
+,name);
+}
+
+static vector<string> split(const string& arg)
+{
+   vector<string> tokens;
+   stringstream strm(arg);
+   string str;
+   while (getline(strm, str, ','))
+      tokens.push_back(str);
+   return tokens;
+}
+
+static bool parse_args(int argc, char *argv[])
+{
+   static struct option opts[] = {
+                                   {"o", required_argument, NULL, 'o'},
+                                   {"measure", required_argument, NULL, 'm'},
+                                   {"markers", required_argument, NULL, 'k'},
+                                   {"intervals", required_argument, NULL, 'i'},
+                                   {"pulses", required_argument, NULL, 'p'},
+                                   {"tones", required_argument, NULL, 't'},
+                                   {"chan", required_argument, NULL, 'c'},
+                                   {"cut", required_argument, NULL, 'x'},
+                                   {"h", no_argument, NULL, 'h'},
+                                   { 0,0,0,0} };
+   int cmd;
+   bool ret = true;
+   vector<string> tokens;
+   opterr = 0;
+
+   while ((cmd = getopt_long_only(argc, argv, "", opts, NULL )) != -1)
+   {
+      switch (cmd)
+      {
+         case 'o':
+               OutName = optarg;
+               break;
+         case 'm':
+               MeasureName = optarg;
+               break;
+         case 'k':
+               MarkerName = optarg;
+               break;
+         case 'i':
+               Intervals.clear();
+               for (auto& tok : split(optarg))
+                  Intervals.push_back(atoi(tok.c_str()));
+               break;
+         case 'p':
+               Pulses = atoi(optarg);
+               break;
+         case 't':
+               Tones.clear();
+               for (auto& tok : split(optarg))
+                  Tones.push_back(atof(tok.c_str()));
+               break;
+         case 'c':
+               SyncChan = atoi(optarg);
+               break;
+         case 'x':
+               tokens = split(optarg);
+               if (tokens.size() != 2)
+               {
+                  cout << "-cut is block,count" << endl;
+                  ret = false;
+                  break;
+               }
+               CutAt = atoll(tokens[0].c_str());
+               CutLen = atoll(tokens[1].c_str());
+               break;
+         case 'h':
+         case '?':
+         default:
+            usage(argv[0]);
+            ret = false;
+            break;
+      }
+   }
+   if (ret && OutName.empty() && MeasureName.empty() && MarkerName.empty())
+   {
+      usage(argv[0]);
+      ret = false;
+   }
+   if (ret && (SyncChan < 1 || SyncChan > CYG_CHANS || Tones.size() > CYG_CHANS - 1 || Pulses < 2 || Intervals.empty()
+               || any_of(Intervals.begin(), Intervals.end(), [] (int intv) {return intv <= 2 * PULSE_HALF;})))
+   {
+      cout << "The timing chan is 1 to 16, there can be up to 15 tones, 2 or more pulses, "
+           << "and intervals more than " << 2 * PULSE_HALF << " samples." << endl;
+      ret = false;
+   }
+   return ret;
+}
+
+static int sync_word()
+{
+   return rev_cmap.at(SyncChan) - 1;
+}
+
+// tape word of tone idx, the words in order skipping the timing one
+static int tone_word(size_t idx)
+{
+   return idx < static_cast<size_t>(sync_word()) ? idx : idx + 1;
+}
+
+static off_t first_peak()
+{
+   return CYG_HEAD_BLOCKS + LEAD_IN;
+}
+
+static double tone_phase(size_t idx, double blk)
+{
+   return 2 * M_PI * Tones[idx] / CYG_RATE * blk + 0.3 * idx;
+}
+
+static void make_tape()
+{
+   vector<off_t> peaks;
+   off_t peak = first_peak();
+   vector<Frame> blocks;
+   vector<char> header(TAPE_SECTOR_SIZ, 0);
+   const int sync = sync_word();
+
+   for (int pulse = 0; pulse < Pulses; ++pulse)
+   {
+      peaks.push_back(peak);
+      peak += Intervals[pulse % Intervals.size()];
+   }
+   blocks.resize(peaks.back() + 3000 - CYG_HEAD_BLOCKS);
+   for (size_t idx = 0; idx < blocks.size(); ++idx)
+   {
+      Frame& frame = blocks[idx];
+      off_t blk = idx + CYG_HEAD_BLOCKS;
+      frame.fill(0);
+      for (size_t tone = 0; tone < Tones.size(); ++tone)
+         frame[tone_word(tone)] = lrint(TONE_AMP * sin(tone_phase(tone, blk)));
+      frame[sync] = -5;   // a little negative between pulses
+   }
+   for (off_t top : peaks)
+      for (int off = -PULSE_HALF; off <= PULSE_HALF; ++off)
+         blocks[top + off - CYG_HEAD_BLOCKS][sync] = 100 * (PULSE_HALF + 1 - abs(off));
+   if (CutLen)
+   {
+      off_t from = max(CutAt - CYG_HEAD_BLOCKS, static_cast<off_t>(0));
+      off_t to = min(from + CutLen, static_cast<off_t>(blocks.size()));
+      blocks.erase(blocks.begin() + from, blocks.begin() + to);
+   }
+   header[9] = 1;   // cdat_type
+   ofstream out(OutName, ios::binary);
+   out.write(header.data(), header.size());
+   out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * CYG_CHAN_BLOCK);
+   if (!out)
+   {
+      cout << "FATAL ERROR: Could not write " << OutName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   cout << "Wrote " << OutName << ", " << Pulses << " pulses from block " << first_peak() << endl;
+}
+
+static bool read_output(const string& name, vector<Frame>& blocks)
+{
+   ifstream in(name, ios::binary | ios::ate);
+   if (!in)
+      return false;
+   blocks.resize(in.tellg() / CYG_CHAN_BLOCK);
+   in.seekg(0);
+   in.read(reinterpret_cast<char*>(blocks.data()), blocks.size() * CYG_CHAN_BLOCK);
+   return static_cast<bool>(in);
+}
+
+/* Where cyg2cyg25KHz puts 25 KHz sample m of the interval that starts at
+   peak, in 24 KHz blocks. Its kernels place them on a grid from the peak,
+   and the interval's samples are one block back from there, see
+   upsample_serial in cyg2cyg25KHz.
+*/
+static double sample_pos(off_t peak, int samples, int m)
+{
+   int err = samples - IDEAL_CYG;
+   double spacing = (IDEAL_CYG + err) / (CYG_RATE + 5 * err) / (samples - 1);
+   return peak - 1 + (m + 1) * DAQ_RATE_SEC / spacing;
+}
+
+/* Least squares fit of a sin + b cos + c at the tone's phases, the 3x3
+   normal equations solved by elimination. Returns the amplitude, and the
+   squared residual is added to sres.
+*/
+static double fit_tone(const vector<double>& phase, const vector<double>& y, double& sres)
+{
+   double mat[3][4] = {};
+   for (size_t idx = 0; idx < y.size(); ++idx)
+   {
+      double basis[3] = {sin(phase[idx]), cos(phase[idx]), 1.0};
+      for (int row = 0; row < 3; ++row)
+      {
+         mat[row][3] += basis[row] * y[idx];
+         for (int col = 0; col < 3; ++col)
+            mat[row][col] += basis[row] * basis[col];
+      }
+   }
+   for (int piv = 0; piv < 3; ++piv)
+      for (int row = 0; row < 3; ++row)
+         if (row != piv)
+         {
+            double scale = mat[row][piv] / mat[piv][piv];
+            for (int col = 0; col < 4; ++col)
+               mat[row][col] -= scale * mat[piv][col];
+         }
+   double a = mat[0][3] / mat[0][0], b = mat[1][3] / mat[1][1], c = mat[2][3] / mat[2][2];
+   for (size_t idx = 0; idx < y.size(); ++idx)
+   {
+      double err = y[idx] - (a * sin(phase[idx]) + b * cos(phase[idx]) + c);
+      sres += err * err;
+   }
+   return sqrt(a * a + b * b);
+}
+
+/* The first two intervals and the last three are left out, the first is
+   done differently and the ends are near the lead-in and tail.
+*/
+static void measure()
+{
+   vector<Frame> blocks;
+   const int samples = Intervals[0];
+
+   if (Intervals.size() != 1 || CutLen)
+   {
+      cout << "FATAL ERROR: -measure needs a tape made with one interval and no cut" << endl
+           << "Exiting. . ." << endl;
+      exit(1);
+   }
+   if (!read_output(MeasureName, blocks) ||
+       static_cast<off_t>(blocks.size()) < first_peak() + static_cast<off_t>(Pulses - 2) * DAQ_INTV)
+   {
+      cout << "FATAL ERROR: Could not read " << MeasureName << " or it is too short" << endl
+           << "Exiting. . ." << endl;
+      exit(1);
+   }
+   printf("%9s %10s %12s\n", "Hz", "gain dB", "residual dB");
+   for (size_t tone = 0; tone < Tones.size(); ++tone)
+   {
+      double gain = 0, sres = 0, power = 0;
+      int intervals = 0;
+      for (int intv = 2; intv < Pulses - 3; ++intv)
+      {
+         vector<double> phase, y;
+         off_t peak = first_peak() + static_cast<off_t>(intv) * samples;
+         off_t out = first_peak() + static_cast<off_t>(intv) * DAQ_INTV;
+         for (int m = 0; m < DAQ_INTV; ++m)
+         {
+            phase.push_back(tone_phase(tone, sample_pos(peak, samples, m)));
+            y.push_back(blocks[out + m][tone_word(tone)]);
+         }
+         double amp = fit_tone(phase, y, sres);
+         gain += amp;
+         power += amp * amp / 2 * DAQ_INTV;
+         ++intervals;
+      }
+      printf("%9.0f %10.3f %12.1f\n", Tones[tone], 20 * log10(gain / intervals / TONE_AMP), 10 * log10(sres / power));
+   }
+}
+
+static void count_markers()
+{
+   vector<Frame> blocks;
+   if (!read_output(MarkerName, blocks))
+   {
+      cout << "FATAL ERROR: Could not read " << MarkerName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   cout << count_if(blocks.begin(), blocks.end(), [] (const Frame& frame) {
+              return all_of(frame.begin(), frame.end(), [] (short val) {return val == GAP_MARKER;});})
+        << endl;
+}
+
+int main (int argc, char **argv)
+{
+   if (!parse_args(argc, argv))
+      exit(1);
+   if (OutName.size())
+      make_tape();
+   if (MeasureName.size())
+      measure();
+   if (MarkerName.size())
+      count_markers();
+   return 0;
+}
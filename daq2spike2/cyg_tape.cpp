@@ -0,0 +1,227 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Buffered tape image reader, see cyg_tape.h */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+
+#include "cyg_tape.h"
+
+using namespace std;
+
+const size_t TAPE_ALIGN = 4096;
+
+
+bool TapeReader::open(const string& name)
+{
+   struct stat info;
+
+   close();
+   fd = ::open(name.c_str(), O_RDONLY);
+   if (fd < 0)
+      return false;
+   if (fstat(fd, &info) == 0)
+      fileSize = info.st_size;
+   posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+   for (size_t idx = 0; idx < TAPE_BUFFS; ++idx)
+   {
+      void* mem;
+      if (posix_memalign(&mem, TAPE_ALIGN, TAPE_BUFF_SIZ) != 0)
+      {
+         cout << "FATAL: Out of memory for tape buffers" << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+      memory.push_back(static_cast<char*>(mem));
+      Buff buff;
+      buff.data = memory.back();
+      empty.push_back(buff);
+   }
+   pos = readFrom = 0;
+   atEof = done = stop = false;
+   worker = thread(&TapeReader::reader, this);
+   return true;
+}
+
+
+void TapeReader::close()
+{
+   if (worker.joinable())
+   {
+      {
+         lock_guard<mutex> guard(lock);
+         stop = true;
+      }
+      ready.notify_all();
+      worker.join();
+   }
+   full.clear();
+   empty.clear();
+   current = Buff();
+   for (auto mem : memory)
+      free(mem);
+   memory.clear();
+   if (fd >= 0)
+      ::close(fd);
+   fd = -1;
+   fileSize = 0;
+}
+
+
+void TapeReader::seek(off_t where)
+{
+   pos = where;
+   atEof = false;
+   if (current.data && where >= current.start && where < current.start + (off_t) current.len)
+      return;
+     // somewhere else, throw away what was read ahead and start over there
+   lock_guard<mutex> guard(lock);
+   ++gen;
+   for (auto& buff : full)
+      empty.push_back(buff);
+   full.clear();
+   if (current.data)
+      empty.push_back(current);
+   current = Buff();
+   readFrom = where;
+   done = false;
+   ready.notify_all();
+}
+
+
+size_t TapeReader::read(char* dest, size_t len)
+{
+   size_t copied = 0;
+
+   while (copied < len)
+   {
+      if (current.data && pos >= current.start && pos < current.start + (off_t) current.len)
+      {
+         size_t offset = pos - current.start;
+         size_t count = min(len - copied, current.len - offset);
+         memcpy(dest + copied, current.data + offset, count);
+         copied += count;
+         pos += count;
+      }
+      else if (!next_buff())
+         break;
+   }
+   if (copied < len)
+      atEof = true;
+   return copied;
+}
+
+
+size_t TapeReader::read_at(off_t where, char* dest, size_t len) const
+{
+   size_t got = 0;
+
+   while (got < len)
+   {
+      ssize_t res = pread(fd, dest + got, len - got, where + got);
+      if (res < 0 && errno == EINTR)
+         continue;
+      if (res <= 0)
+         break;
+      got += res;
+   }
+   return got;
+}
+
+
+// Hand the used buffer back and wait for the next one. False at the end.
+bool TapeReader::next_buff()
+{
+   unique_lock<mutex> guard(lock);
+   if (current.data)
+   {
+      empty.push_back(current);
+      current = Buff();
+      ready.notify_all();
+   }
+   ready.wait(guard, [this]{return !full.empty() || done;});
+   if (full.empty())
+      return false;
+   current = full.front();
+   full.pop_front();
+   return true;
+}
+
+
+/* Read ahead thread. Fill empty buffers from readFrom on until the end
+   of the file. A seek while a read is in progress changes gen, and that
+   buffer is thrown away when it comes back.
+*/
+void TapeReader::reader()
+{
+   unique_lock<mutex> guard(lock);
+   while (true)
+   {
+      ready.wait(guard, [this]{return stop || (!empty.empty() && !done);});
+      if (stop)
+         break;
+      Buff buff = empty.front();
+      empty.pop_front();
+      buff.start = readFrom;
+      buff.gen = gen;
+      guard.unlock();
+
+      size_t got = 0;
+      bool bad = false;
+      while (got < TAPE_BUFF_SIZ)
+      {
+         ssize_t res = pread(fd, buff.data + got, TAPE_BUFF_SIZ - got, buff.start + got);
+         if (res < 0 && errno == EINTR)
+            continue;
+         if (res < 0)
+         {
+            cout << endl << "Error reading tape: " << strerror(errno) << endl;
+            bad = true;
+         }
+         if (res <= 0)
+            break;
+         got += res;
+      }
+
+      guard.lock();
+      if (buff.gen != gen)   // a seek happened, this is not wanted now
+      {
+         empty.push_back(buff);
+         continue;
+      }
+      buff.len = got;
+      readFrom += got;
+      if (got < TAPE_BUFF_SIZ || bad)
+         done = true;
+      if (got)
+         full.push_back(buff);
+      else
+         empty.push_back(buff);
+      ready.notify_all();
+   }
+}
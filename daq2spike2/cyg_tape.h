@@ -0,0 +1,95 @@
+#ifndef _CYG_TAPE_H
+#define _CYG_TAPE_H
+
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Sequential reader for cygnus tape images.
+
+   The tools read a tape one 32 byte sample block at a time. Through an
+   ifstream that is a library call per block, per tape. TapeReader reads a
+   tape in big page aligned buffers of whole tape sectors, and a thread
+   reads the next buffer while the current one is used, so the disk stays
+   busy while the caller works.
+
+   read() acts like ifstream::read: a short read copies what is left and
+   sets eof, and the rest of the caller's buffer is left as it was.
+   seek() clears eof, a position past the end just reads nothing.
+*/
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
+
+const size_t TAPE_SECTOR_SIZ = 65024;              // bytes in a tape sector
+const size_t TAPE_BUFF_SIZ = TAPE_SECTOR_SIZ * 64; // about 4 MB per read
+const size_t TAPE_BUFFS = 3;                       // one in use, two ahead
+
+class TapeReader
+{
+   public:
+      TapeReader() {}
+      ~TapeReader() {close();}
+      TapeReader(const TapeReader&) = delete;
+      TapeReader& operator=(const TapeReader&) = delete;
+      bool open(const std::string& name);
+      void close();
+      bool is_open() const {return fd >= 0;}
+      bool eof() const {return atEof;}
+      off_t size() const {return fileSize;}
+      off_t tell() const {return pos;}
+      void seek(off_t where);
+      void skip(off_t bytes) {seek(pos + bytes);}
+      size_t read(char* dest, size_t len);
+        // read from anywhere without moving or disturbing the read ahead,
+        // safe to call from another thread
+      size_t read_at(off_t where, char* dest, size_t len) const;
+
+   private:
+      struct Buff
+      {
+         char* data = nullptr;
+         off_t start = 0;
+         size_t len = 0;
+         unsigned gen = 0;
+      };
+      bool next_buff();
+      void reader();
+      int fd = -1;
+      off_t fileSize = 0;
+      off_t pos = 0;
+      bool atEof = false;
+      Buff current;
+      std::vector<char*> memory;
+      std::thread worker;
+      std::mutex lock;
+      std::condition_variable ready;
+      std::deque<Buff> full;
+      std::deque<Buff> empty;
+      off_t readFrom = 0;  // where the reader thread goes next
+      unsigned gen = 0;    // bumped on a seek, older buffers are stale
+      bool done = false;   // reader hit the end for this gen
+      bool stop = false;
+};
+
+#endif
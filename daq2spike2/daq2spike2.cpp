@@ -33,6 +33,8 @@ This file is part of a collection of recording processing software.
 
    Mod History
    Mon Feb 25 09:57:36 EST 2019 dale add this comment.
+   Sun Oct 18 2026 Read gzipped .daq.gz files directly.
+   Sun Oct 18 2026 Write the .smr file with DaqSmrWriter, shared with cyg2daq.
 */
 
 #include <sys/types.h>
@@ -44,33 +46,23 @@ This file is part of a collection of recording processing software.
 #include <vector>
 #include <array>
 #include <string>
-#include <sstream>
+#include <algorithm>
 #include <memory>
 #include <chrono>
 #include <ctime>
 
-#include "s64.h"
-#include "s3264.h"
-#include "s32priv.h"
-
-// buried in the s64 code, this is the default buff size when creating wave chans
-#define S32_BUFSZ 0x8000 
+#include "gzstream.h"
+#include "daq_smr.h"
 
 using namespace std;
 using namespace ceds64;
 
-const int wordsPerSamp = 66;
+const int wordsPerSamp = DAQ_REC_WORDS;
 const int bytesPerSamp = wordsPerSamp * sizeof(short); // 2 words header, 64 words data
-const int dataPerSamp = 64 * 2;  // 64 words data
-// 32 disk blocks (16K) will hold 20 byte header, 8182 samples, no pad
-const int blocksPerChan = 64;
-const int sampsPerBlock = (blocksPerChan*DISKBLOCK - SONDBHEADSZ) / sizeof(short);
-const int bytesPerBlock = (blocksPerChan*DISKBLOCK - SONDBHEADSZ);
-const int daqChansPerFile = 64;
-const int daqChans = 128;
+const int sampsPerBlock = SMR_SAMPS_PER_BLOCK;
+const int daqChansPerFile = DAQ_REC_CHANS;
+const int daqChans = SMR_MAX_CHANS;
 int realDaqChans = daqChans;
-// use same size blocks, even if last one only has 1 sample in it
-const unsigned long stdBlkSize = (SONDBHEADSZ + (sampsPerBlock) * sizeof(TAdc)) / DISKBLOCK;
 
 // LUT stuff from son32 son.c file
 // Globals
@@ -99,6 +91,7 @@ static void usage(char *name)
    << endl << "differ slihtly."
    << endl << "Note: You must put it in quotes because it contains a space."
    << endl << "This must be run from the directory containing the daq2 files."
+   << endl << "Gzipped files, such as 2014-06-24_001_1-64.daq.gz, are read directly."
    << endl;
 }
 
@@ -151,17 +144,18 @@ static int parse_args(int argc, char *argv[])
 }
 
 // Create some useful info 
-static void initConsts(FILE* in_fd0, FILE* in_fd1)
+static void initConsts(igzstream& in0, igzstream* in1)
 {
-   struct stat stats0;
-   struct stat stats1;
    unsigned long bytesPerSegment = bytesPerSamp*sampsPerBlock;
 
-   fstat(in_fd0->_fileno,&stats0);
-   if (in_fd1)
+   if (in0.compressed() || (in1 && in1->compressed()))
+   {
+      cout << "Compressed input, the number of blocks is known once it has been read." << endl;
+      return;
+   }
+   if (in1)
    {
-      fstat(in_fd1->_fileno,&stats1);
-      if (stats0.st_size != stats1.st_size)
+      if (in0.raw_size() != in1->raw_size())
       {
          cout << "FATAL: The .daq files must be the same size." 
               << endl <<  "Are these from the same recording?" 
@@ -169,97 +163,63 @@ static void initConsts(FILE* in_fd0, FILE* in_fd1)
          exit(1);
       }
    }
-   bytesPerSegment = bytesPerSamp*sampsPerBlock;
-   wholeBlocks = stats0.st_size / bytesPerSegment;
-   shortBlock = (stats0.st_size - (wholeBlocks * bytesPerSegment)) / bytesPerSamp;
+   wholeBlocks = in0.raw_size() / bytesPerSegment;
+   shortBlock = (in0.raw_size() - (wholeBlocks * bytesPerSegment)) / bytesPerSamp;
    totalBlocks = wholeBlocks;
    if (shortBlock)  // if data exactly fits in wholeblocks, no short block at end
       ++totalBlocks;
-   maxTick = stats0.st_size / wordsPerSamp; // each block of data is a tick
+   maxTick = in0.raw_size() / wordsPerSamp; // each block of data is a tick
    cout << "Whole blocks: " << wholeBlocks << endl << "Samps in last short block: " << shortBlock << endl;
    cout << "MaxTick: " << maxTick << endl;
 }
 
-static short daqData[daqChans][sampsPerBlock];    /* ADC data */
+static vector<unsigned short> inBuff0(static_cast<size_t>(sampsPerBlock) * wordsPerSamp);
+static vector<unsigned short> inBuff1(static_cast<size_t>(sampsPerBlock) * wordsPerSamp);
 
-static void convertData(FILE* in_fd0, FILE* in_fd1, TSon32File& sFile)
+// read up to sampsPerBlock whole records, return how many
+static int readRecs(igzstream& in, vector<unsigned short>& buff)
 {
-   int recBlock, chan;
-   int currtime = 0;
-   int rec;
-   off_t res;
-   off_t whole;
-   unsigned short *in_ptr;
-   unsigned short inBuff[wordsPerSamp];
-   off_t currpos;
-   struct stat stats;
-
-   fstat(in_fd0->_fileno,&stats);
-   for (whole = 0; whole < totalBlocks; ++whole)
-   {
-      for (recBlock = 0; recBlock < sampsPerBlock; ++recBlock) // first file 1-64
-      {
-         rec = fread(&inBuff, sizeof(inBuff), 1,  in_fd0);
-         if (!rec)
-            break;
-         in_ptr = inBuff;
-         in_ptr += 2;    // skip 0000 0000 header
-          // the daq stores data as "offset binary", so ffff is max pos, 0x8000 is zero,
-          // and 0 is max neg. Spike2 wants signed shorts.
-         for (chan = 0; chan < daqChansPerFile; ++chan, in_ptr++)
-            daqData[chan][recBlock] = *in_ptr - 0x8000;
-      }
-      if (in_fd1) // second file 65-128, if we have one
-      {
-         for (recBlock = 0; recBlock < sampsPerBlock; ++recBlock)
-         {
-            rec = fread(&inBuff, sizeof(inBuff), 1,  in_fd1);
-            if (!rec)
-               break;
-            in_ptr = inBuff;
-            in_ptr += 2;    // skip 0000 0000 header
-            for (chan = daqChansPerFile; chan < daqChans; ++chan, in_ptr++)
-               daqData[chan][recBlock] = *in_ptr - 0x8000;
-         }
-      }
+   in.read(reinterpret_cast<char*>(buff.data()), buff.size() * sizeof(short));
+   return in.gcount() / bytesPerSamp;
+}
 
-      for (chan = 0; chan < realDaqChans; ++chan)
-      {
-         res = sFile.WriteWave(chan, &daqData[chan][0], recBlock, currtime);
-         if (res < 0)
-            cout << "write error " << res << endl;
-      }
-//      sFile.Commit(); // The lib saves the first 2 samples out of the order we
-                        // write them if we do not force a flush. This makes
-                        // comparing the output of this and local_daq2spike2
-                        // difficult. Since we are using this as primary
-                        // conversion tool, this is not needed.
-      currtime += recBlock;
+/* Read a block of samples from each file and write them to the smr chans.
+   Stop at the first empty block, the sizes of compressed files are not
+   known in advance. If one file is shorter, only the samples both have
+   are used.
+*/
+static void convertData(igzstream& in0, igzstream* in1, DaqSmrWriter& smr)
+{
+   int recBlock;
+
+   while (true)
+   {
+      recBlock = readRecs(in0, inBuff0);  // first file 1-64
+      if (in1) // second file 65-128, if we have one
+         recBlock = min(recBlock, readRecs(*in1, inBuff1));
+      if (recBlock == 0)
+         break;
+      smr.add(inBuff0.data(), in1 ? inBuff1.data() : nullptr, recBlock);
       float percent;
-      currpos = ftell(in_fd0);
-      percent = 100.0 * (float)currpos / stats.st_size;
+      percent = 100.0 * (float)in0.raw_pos() / in0.raw_size();
       printf("\rProcessed: %3.0f%%  ", percent);
       fflush(stdout);
    }
    printf("\rProcessed: %3.1f%%  ", 100.0);
-   if (feof(in_fd0) || feof(in_fd1))
+   if (in0.failed() || (in1 && in1->failed()))
+      cout << "Could not decompress all of the data, the .smr file is incomplete" << endl;
+   else if (in0.eof() || (in1 && in1->eof()))
       cout << "EOF" << endl;
    else
       cout << "We seem to have ran out of data before we ran out of file" << endl;
-   sFile.Close();
-   // need to mod permissions, they are rw------- by default, not what we want
-   chmod(outFile.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+   smr.close();
 }
 
 
 int main(int argc, char*argv[])
 {
-   FILE *in_fd0 = NULL;
-   FILE *in_fd1 = NULL;
-   int chan;
-   int res;
-   char text[128];
-   TTimeDate td;
+   igzstream in_fd0;
+   igzstream in_fd1;
 
    cout << "Program to convert .daq files to Spike2 .smr files." << endl <<"Version " << VERSION << endl;
    parse_args(argc,argv);
@@ -269,16 +229,16 @@ int main(int argc, char*argv[])
       cout << "Aborting. . ." << endl;
       exit(1);
    }
-   File0 = baseName + "_1-64.daq";
-   File1 = baseName + "_65-128.daq";
-   in_fd0 = fopen(File0.c_str(),"rb");
-   if (!in_fd0)
+   File0 = gz_name(baseName + "_1-64.daq");
+   File1 = gz_name(baseName + "_65-128.daq");
+   in_fd0.open(File0);
+   if (!in_fd0.is_open())
    {
       cout << "Could not open " << File0 << endl << "Aborting. . ." << endl;
       exit(1);
    }
-   in_fd1 = fopen(File1.c_str(),"rb");
-   if (!in_fd1)
+   in_fd1.open(File1);
+   if (!in_fd1.is_open())
    {
       cout << "Could not open " << File1 << endl << "Using one recording file." << endl;
       realDaqChans = daqChansPerFile;
@@ -288,59 +248,21 @@ int main(int argc, char*argv[])
 
    outFile = baseName + "_from_daq.smr";
 
-   initConsts(in_fd0, in_fd1);
-   SONInitFiles();   // using static lib, have to do this
-   TSon32File sFile(1);
-   res = sFile.Create(outFile.c_str(),realDaqChans);
-   if (res == S64_OK)
+   initConsts(in_fd0, in_fd1.is_open() ? &in_fd1 : nullptr);
+   vector<string> comments;
+   auto now = chrono::system_clock::now();
+   time_t nowtime = chrono::system_clock::to_time_t(now);
+   comments.push_back("DAQ file Conversion to smr format.");
+   comments.push_back("File 1: " + File0);
+   comments.push_back(in_fd1.is_open() ? "File 2: " + File1 : "");
+   comments.push_back(string("On ") + ctime(&nowtime));
+   DaqSmrWriter smr;
+   if (!smr.create(outFile, realDaqChans, dateStamp, comments))
    {
-      sFile.SetTimeBase(0.000040);
-      sscanf(dateStamp.c_str(),"%hu-%hhu-%hhu %hhu:%hhu:%hhu",
-      &td.wYear,
-      &td.ucMon,
-      &td.ucDay,
-      &td.ucHour,
-      &td.ucMin,
-      &td.ucSec);
-      td.ucHun = 0;
-      sFile.TimeDate(nullptr,&td);
-      stringstream strm;
-      auto now = chrono::system_clock::now();
-      time_t nowtime = chrono::system_clock::to_time_t(now);
-      strm << "DAQ file Conversion to smr format.";
-      sFile.SetFileComment(0,strm.str().c_str());
-      strm.str("");
-      strm.clear();
-      strm << "File 1: "<< File0;
-      sFile.SetFileComment(1,strm.str().c_str());
-      if (in_fd1)
-      {
-         strm.str("");
-         strm.clear();
-         strm << "File 2: "<< File1;
-         sFile.SetFileComment(2,strm.str().c_str());
-      }
-      strm.str("");
-      strm.clear();
-      strm << "On " << ctime(&nowtime);
-      sFile.SetFileComment(3,strm.str().c_str());
-      strm.str("");
-      strm.clear();
-
-
-      for (chan = 0 ; chan < realDaqChans; ++chan)
-      {
-         res = sFile.SetWaveChan(chan,1,ceds64::TDataKind::Adc,0.000040,chan);
-         if (res != S64_OK)
-            cout << "wave chan write res: " << res << endl;
-         sFile.SetChanUnits(chan,"Volts");
-         sprintf(text,"Chan %3d",chan); // 9 chars or less
-         sFile.SetChanTitle(chan,text);
-         sFile.SetChanScale(chan,0.5);  // default is +/-5, we use +/-2.5
-      }
-      sFile.SetBuffering(-1,0x8000,0); // all chans
+      cout << "FATAL: Could not create " << outFile << endl << "Exiting. . ." << endl;
+      exit(1);
    }
-   convertData(in_fd0, in_fd1, sFile);
+   convertData(in_fd0, in_fd1.is_open() ? &in_fd1 : nullptr, smr);
 }
 
 
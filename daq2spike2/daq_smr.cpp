@@ -0,0 +1,156 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* .daq records to .smr, see daq_smr.h */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <iostream>
+#include <algorithm>
+
+#include "daq_smr.h"
+
+using namespace std;
+using namespace ceds64;
+
+
+bool DaqSmrWriter::create(const string& name, int numChans, const string& dateStamp,
+                          const vector<string>& comments)
+{
+   TTimeDate td;
+   char text[128];
+   int res;
+
+   fileName = name;
+   chans = numChans;
+   filled = 0;
+   currtime = 0;
+   data.assign(static_cast<size_t>(chans) * SMR_SAMPS_PER_BLOCK, 0);
+
+   SONInitFiles();   // using static lib, have to do this
+   res = sFile.Create(fileName.c_str(),chans);
+   if (res != S64_OK)
+      return false;
+   sFile.SetTimeBase(SMR_TICK);
+   sscanf(dateStamp.c_str(),"%hu-%hhu-%hhu %hhu:%hhu:%hhu",
+   &td.wYear,
+   &td.ucMon,
+   &td.ucDay,
+   &td.ucHour,
+   &td.ucMin,
+   &td.ucSec);
+   td.ucHun = 0;
+   sFile.TimeDate(nullptr,&td);
+   for (size_t idx = 0; idx < comments.size() && idx < 4; ++idx)
+      if (!comments[idx].empty())
+         sFile.SetFileComment(idx,comments[idx].c_str());
+
+   for (int chan = 0 ; chan < chans; ++chan)
+   {
+      res = sFile.SetWaveChan(chan,1,ceds64::TDataKind::Adc,SMR_TICK,chan);
+      if (res != S64_OK)
+         cout << "wave chan write res: " << res << endl;
+      sFile.SetChanUnits(chan,"Volts");
+      sprintf(text,"Chan %3d",chan); // 9 chars or less
+      sFile.SetChanTitle(chan,text);
+      sFile.SetChanScale(chan,0.5);  // default is +/-5, we use +/-2.5
+   }
+   sFile.SetBuffering(-1,0x8000,0); // all chans
+   return true;
+}
+
+
+/* The daq stores data as "offset binary", so ffff is max pos, 0x8000 is
+   zero, and 0 is max neg. Spike2 wants signed shorts.
+*/
+static short wave_sample(unsigned short val)
+{
+   return val - 0x8000;
+}
+
+static short wave_sample(short val)
+{
+   return val;
+}
+
+template <typename Word>
+void DaqSmrWriter::collect(const Word* first, const Word* second, size_t count)
+{
+   while (count)
+   {
+      size_t take = min(count, static_cast<size_t>(SMR_SAMPS_PER_BLOCK - filled));
+      for (int half = 0; half < 2 && half * DAQ_REC_CHANS < chans; ++half)
+      {
+         const Word* recs = half ? second : first;
+         for (int chan = 0; chan < DAQ_REC_CHANS; ++chan)
+         {
+            short* dest = data.data() + (half * DAQ_REC_CHANS + chan) * SMR_SAMPS_PER_BLOCK + filled;
+            const Word* src = recs + 2 + chan;   // skip 0000 0000 header
+            for (size_t rec = 0; rec < take; ++rec, src += DAQ_REC_WORDS)
+               dest[rec] = wave_sample(*src);
+         }
+      }
+      first += take * DAQ_REC_WORDS;
+      if (second)
+         second += take * DAQ_REC_WORDS;
+      filled += take;
+      count -= take;
+      if (filled == SMR_SAMPS_PER_BLOCK)
+         flush();
+   }
+}
+
+
+void DaqSmrWriter::add(const unsigned short* first, const unsigned short* second, size_t count)
+{
+   collect(first, second, count);
+}
+
+
+void DaqSmrWriter::add(const short* first, const short* second, size_t count)
+{
+   collect(first, second, count);
+}
+
+
+void DaqSmrWriter::flush()
+{
+   int res;
+
+   if (!filled)
+      return;
+   for (int chan = 0; chan < chans; ++chan)
+   {
+      res = sFile.WriteWave(chan, data.data() + chan * SMR_SAMPS_PER_BLOCK, filled, currtime);
+      if (res < 0)
+         cout << "write error " << res << endl;
+   }
+   currtime += filled;
+   filled = 0;
+}
+
+
+void DaqSmrWriter::close()
+{
+   flush();
+   sFile.Close();
+   // need to mod permissions, they are rw------- by default, not what we want
+   chmod(fileName.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+}
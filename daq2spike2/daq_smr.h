@@ -0,0 +1,78 @@
+#ifndef _DAQ_SMR_H
+#define _DAQ_SMR_H
+
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Spike2 .smr output for .daq records, used by daq2spike2 and by cyg2daq
+   when it writes the .smr file itself.
+
+   A .daq record is 2 words of 0 then 64 chans of offset binary, 0x8000 is
+   zero. A recording has one stream of records for chans 0-63 and maybe a
+   second for 64-127. Records are collected a Spike2 block at a time per
+   chan and written as signed 25 KHz Adc wave data, so the file is the same
+   however the records are handed over. cyg2daq hands over records laid
+   out the same way but already signed, so there is no offset binary to
+   undo and -32768 stays -32768.
+*/
+
+#include <string>
+#include <vector>
+
+#include "s64.h"
+#include "s3264.h"
+#include "s32priv.h"
+
+const int DAQ_REC_WORDS = 66;        // 2 words header, 64 words data
+const int DAQ_REC_CHANS = 64;
+const int SMR_MAX_CHANS = 2 * DAQ_REC_CHANS;
+const double SMR_TICK = 0.000040;    // 25 KHz
+// 64 disk blocks will hold 20 byte header, 16374 samples, no pad
+const int SMR_BLOCKS_PER_CHAN = 64;
+const int SMR_SAMPS_PER_BLOCK = (SMR_BLOCKS_PER_CHAN*DISKBLOCK - SONDBHEADSZ) / sizeof(short);
+
+class DaqSmrWriter
+{
+   public:
+      DaqSmrWriter() : sFile(1) {}
+        // chans is 64 or 128. dateStamp is "YYYY-MM-DD hh:mm:ss" and the
+        // comments, up to 4, go in file comments 0 up, empty ones are left
+        // unset. False if the file could not be made.
+      bool create(const std::string& name, int chans, const std::string& dateStamp,
+                  const std::vector<std::string>& comments);
+        // count records from each stream, second is null for 64 chans
+      void add(const unsigned short* first, const unsigned short* second, size_t count);
+        // the same with signed samples
+      void add(const short* first, const short* second, size_t count);
+        // write what is left and close
+      void close();
+
+   private:
+      void flush();
+      template <typename Word>
+      void collect(const Word* first, const Word* second, size_t count);
+      ceds64::TSon32File sFile;
+      std::string fileName;
+      int chans = 0;
+      int filled = 0;
+      ceds64::TSTime64 currtime = 0;
+      std::vector<short> data;   // SMR_SAMPS_PER_BLOCK per chan
+};
+
+#endif
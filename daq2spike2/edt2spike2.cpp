@@ -25,8 +25,17 @@ Ths file is part of a collection of recording processing software.
 
    Mod History
    Thu Apr 25 15:26:00 EDT 2019 Forked from daq2spike2.cpp
+   Sun Oct 18 2026 Add --irregular policy so files with variable analog
+                   sample rates can be converted without a prompt.
+                   Read gzipped .edt.gz/.bdt.gz files directly.
+                   Decode times as 64-bit values and write a 64-bit .smrx
+                   file if they do not fit in a 32-bit .smr file.
+                   Use flat tables indexed by chan id instead of maps
+                   in the per-line loops.
 */
 
+#define _FILE_OFFSET_BITS 64
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -36,7 +45,6 @@ Ths file is part of a collection of recording processing software.
 #include <vector>
 #include <array>
 #include <string>
-#include <map>
 #include <sstream>
 #include <fstream>
 #include <memory>
@@ -44,29 +52,106 @@ Ths file is part of a collection of recording processing software.
 #include <ctime>
 #include <algorithm>
 #include <string.h>
+#include <errno.h>
+#include <limits>
 
 #ifdef WIN32
 #include <windows.h>
 #include <time.h>
 #endif
 
+#include "gzstream.h"
 #include "s64.h"
 #include "s3264.h"
 #include "s32priv.h"
+#include "s64priv.h"
 
 using namespace std;
 using namespace ceds64;
 
-class intv {public: int t0, t1, dt; intv(): t0(0), t1(0),dt(0){} };
-// map is <file chan , smr chan>
-using spikeList = map<int, int>;
-using spikeListIter = spikeList::iterator;
-using analogList = map<int, unsigned int>;
-using analogListIter = analogList::iterator;
-using analogSamp = map<int, intv>;
-using analogSampIter = analogSamp::iterator;
-using analogIntv = map<int, unsigned int>;
-using analogIntvIter = analogIntv::iterator;
+const unsigned int MAX_SPIKE_ID = 4096;  // spike ids are 1-4095
+const unsigned int MAX_ANALOG_ID = 25;   // 5 digit id field / 4096
+const int NO_CHAN = -1;
+
+class intv {public: TSTime64 t0, t1, dt; bool have; intv(): t0(0), t1(0),dt(0),have(false){} };
+// Tables are indexed by file chan and hold the smr chan, or NO_CHAN if
+// the file does not use it. These are looked up for every line, a flat
+// table is much cheaper than a map.
+using spikeList = array<int, MAX_SPIKE_ID>;
+using analogList = array<int, MAX_ANALOG_ID>;
+using analogSamp = array<intv, MAX_ANALOG_ID>;
+
+/* Histogram of analog sample intervals. There are only ever a few
+   distinct ones, so this is a small open-addressed table with linear
+   probing. An empty slot has a count of zero.
+*/
+class IntvHist
+{
+   public:
+      IntvHist() : slots(16) {}
+        // count one more of delta, return true if it is a new interval
+      bool add(TSTime64 delta)
+      {
+         size_t mask = slots.size() - 1;
+         size_t idx = hash(delta) & mask;
+         while (slots[idx].count && slots[idx].delta != delta)
+            idx = (idx + 1) & mask;
+         if (slots[idx].count)
+         {
+            ++slots[idx].count;
+            return false;
+         }
+         slots[idx].delta = delta;
+         slots[idx].count = 1;
+         if (++used * 4 > slots.size() * 3)
+            grow();
+         return true;
+      }
+      size_t size() const {return used;}
+        // (interval, count) in interval order
+      vector<pair<TSTime64, unsigned long>> sorted() const
+      {
+         vector<pair<TSTime64, unsigned long>> list;
+         for (auto& slot : slots)
+            if (slot.count)
+               list.emplace_back(slot.delta, slot.count);
+         sort(list.begin(), list.end());
+         return list;
+      }
+
+   private:
+      class Slot {public: TSTime64 delta = 0; unsigned long count = 0;};
+      static size_t hash(TSTime64 delta) {return (uint64_t) delta * 0x9e3779b97f4a7c15ULL >> 32;}
+      void grow()
+      {
+         vector<Slot> old(slots.size() * 2);
+         old.swap(slots);
+         used = 0;
+         for (auto& slot : old)
+            if (slot.count)
+            {
+               size_t mask = slots.size() - 1;
+               size_t idx = hash(slot.delta) & mask;
+               while (slots[idx].count)
+                  idx = (idx + 1) & mask;
+               slots[idx] = slot;
+               ++used;
+            }
+      }
+      vector<Slot> slots;
+      size_t used = 0;
+};
+
+// What to do with analog chans when a bdt file has more than one sample rate
+enum IrregPolicy {IRREG_PROMPT, IRREG_RESAMPLE, IRREG_REALMARK, IRREG_ABORT};
+
+// Gaps longer than this many sample intervals are left as gaps when
+// resampling, we do not invent data across an edit or a dropout.
+const TSTime64 MAX_RESAMP_GAP = 4;
+const size_t WAVE_BUFF_SIZ = 0x4000;   // samples per WriteWave call
+const size_t MARK_BUFF_SIZ = 0x1000;   // markers per WriteExtMarks call
+// Times in a 32-bit .smr file are 32-bit ticks
+const TSTime64 MAX_SON32_TIME = numeric_limits<int32_t>::max();
 
 // globals
 string inName;
@@ -77,17 +162,29 @@ TSTime64 sampIntv;
 spikeList sChans;
 analogList aChans;
 analogSamp intvChans;
-analogIntv Intervals;
+IntvHist Intervals;
+int numSpike = 0;
+int numAnalog = 0;
 bool isEdt = true;
+bool isSon64 = false;   // need a .smrx file for times past MAX_SON32_TIME
+IrregPolicy irregPolicy = IRREG_PROMPT;
+bool interpLinear = true;
 
 static void usage(char *name)
 {
    cout << endl << "Usage: "
-   << name << " -n <filename.edt | filename.bdt>"
+   << name << " -n <filename.edt | filename.bdt> [-irregular=resample|realmark|abort] [-interp=linear|hold]"
    << endl << "For example: "
    << endl << endl << name << " -n 2014-06-24_001.edt" << endl
    << "or" << endl
    << name << " -n c:\\path\\to\\2014-06-24_001.edt" << endl
+   << endl << "Gzipped files, such as 2014-06-24_001.edt.gz, are read directly." << endl
+   << endl << "If the analog chans have more than one sample rate, the program asks"
+   << endl << "what to do unless -irregular is used:"
+   << endl << "   resample  put the samples on the most common sample interval grid,"
+   << endl << "             using -interp=linear (the default) or hold (zero-order hold)"
+   << endl << "   realmark  keep the samples at their real times in RealMark chans"
+   << endl << "   abort     exit without creating a .smr file"
    << endl;
 }
 
@@ -98,9 +195,12 @@ static int parse_args(int argc, char *argv[])
    static struct option opts[] =
    {
       {"n", required_argument, NULL, 'n'},
+      {"irregular", required_argument, NULL, 'i'},
+      {"interp", required_argument, NULL, 'p'},
       {"h", no_argument, NULL, 'h'},
       { 0,0,0,0}
    };
+   string arg;
    while ((cmd = getopt_long_only(argc, argv, "", opts, NULL )) != -1)
    {
       switch (cmd)
@@ -114,6 +214,34 @@ static int parse_args(int argc, char *argv[])
                }
                break;
 
+         case 'i':
+               arg = optarg;
+               if (arg == "resample")
+                  irregPolicy = IRREG_RESAMPLE;
+               else if (arg == "realmark")
+                  irregPolicy = IRREG_REALMARK;
+               else if (arg == "abort")
+                  irregPolicy = IRREG_ABORT;
+               else
+               {
+                  cout << "Unknown -irregular policy: " << arg << endl;
+                  ret = 0;
+               }
+               break;
+
+         case 'p':
+               arg = optarg;
+               if (arg == "linear")
+                  interpLinear = true;
+               else if (arg == "hold")
+                  interpLinear = false;
+               else
+               {
+                  cout << "Unknown -interp method: " << arg << endl;
+                  ret = 0;
+               }
+               break;
+
          case 'h':
          case '?':
          default:
@@ -132,6 +260,30 @@ static int parse_args(int argc, char *argv[])
 }
 
 
+/* Decode the id and time fields of an edt/bdt line. The id is the first 5
+   chars, the time is the rest of the line. Times are 64-bit, anything that
+   does not fit is a fatal error rather than a silent wrap.
+*/
+static void parseLine(const string& line, unsigned long lineNum, unsigned int& id, TSTime64& time)
+{
+   char field[6] = {0};
+
+   line.copy(field, 5);
+   id = atoi(field);
+   time = 0;
+   if (line.size() <= 5)
+      return;
+   errno = 0;
+   long long val = strtoll(line.c_str() + 5, nullptr, 10);
+   if (errno == ERANGE)
+   {
+      cout << "Time on line " << lineNum << " is too large: " << line << endl
+           << "Exiting. . ." << endl;
+      exit(1);
+   }
+   time = val;
+}
+
 /* Scan the file and see how many channels of what kind we have.
    Build lists and assign chan #s in edt/scope order.
    For BDT files, the analog sample rate can vary, so determine what it
@@ -143,12 +295,15 @@ void readFile()
    string line;
    unsigned int id;
    TSTime64 time;
-   TSTime64 max_val = 0;
-   analogSampIter sampIter;
-   analogIntvIter intvIter;
+   unsigned long max_val = 0;
+   TSTime64 max_time = 0;
+   unsigned long lineNum = 2;
    string choice;
 
-   ifstream in_file(inName.c_str());
+   sChans.fill(NO_CHAN);
+   aChans.fill(NO_CHAN);
+
+   igzstream in_file(inName);
    if (!in_file.is_open())
    {
       cout << "Could not open " << inName << endl << "Exiting. . ." << endl;
@@ -179,36 +334,40 @@ void readFile()
    cout << "Reading " << inName << " (this may take a while)" << endl;
    while (getline(in_file,line))
    {
-      id = atoi(line.substr(0,5).c_str());
-      time = atoi(line.substr(5).c_str());
-      if (id < 4096 && id != 0)
+      parseLine(line, ++lineNum, id, time);
+      if (time > max_time)
+         max_time = time;
+      if (id < MAX_SPIKE_ID && id != 0)
       {
-         if (sChans.find(id) == sChans.end())
-            sChans.insert(make_pair(id,0));
+         sChans[id] = 0;
       }
-      else if (id >= 4096)  // analog channel
+      else if (id >= MAX_SPIKE_ID)  // analog channel
       {
          id /= 4096;
-         if (aChans.find(id) == aChans.end())
-            aChans.insert(make_pair(id, 0));
-         if ((sampIter = intvChans.find(id)) == intvChans.end())
+         if (id >= MAX_ANALOG_ID)
          {
-            sampIter = intvChans.insert(make_pair(id, intv())).first;
-            sampIter->second.t1 = time;
+            cout << "Bad analog chan on line " << lineNum << ": " << line << endl
+                 << "Exiting. . ." << endl;
+            exit(1);
+         }
+         aChans[id] = 0;
+         intv& samp = intvChans[id];
+         if (!samp.have)
+         {
+            samp.have = true;
+            samp.t1 = time;
          }
          else
          {
-            sampIter->second.t0 = sampIter->second.t1;
-            sampIter->second.t1 = time;
-            off_t delta = sampIter->second.t1 - sampIter->second.t0;
-            if ((intvIter = Intervals.find(delta)) == Intervals.end())
+            samp.t0 = samp.t1;
+            samp.t1 = time;
+            TSTime64 delta = samp.t1 - samp.t0;
+            if (Intervals.add(delta))
             {
-               intvIter = Intervals.insert(make_pair(delta,0)).first;
                cout << "new: " << id << " gap:  " << delta << endl;
-               cout << "tn:   " << sampIter->second.t0 << endl 
-                    << "tn+1: " << sampIter->second.t1 << endl;
+               cout << "tn:   " << samp.t0 << endl 
+                    << "tn+1: " << samp.t1 << endl;
             }
-            intvIter->second++;
          }
       }
    }
@@ -216,47 +375,206 @@ void readFile()
    {
       cout << "The are variable sampling rates for this file." << endl
            << "Here are the rates: " << endl; 
-      for (auto iter : Intervals)
+      for (auto iter : Intervals.sorted())
          cout << "Rate: " << iter.first << " Occurences: " << iter.second << endl;
-      cout << "If there are many instances of the rates, the spike2 file " << endl
-           << "will be large and mostly unusable." << endl
-           << "If there are just a few, as a side-effect of edits," << endl
-           << "the spike2 file will be okay." << endl
-           << "Do you want to continue (type y for yes, anything else for no): ";
-      getline(cin,choice);
-      if (choice[0] != 'y' && choice[0] != 'Y')
+      switch (irregPolicy)
       {
-         cout << "Exiting. . ." << endl;
-         exit(1);
+         case IRREG_RESAMPLE:
+            cout << "Analog samples will be resampled to the most common rate." << endl;
+            break;
+
+         case IRREG_REALMARK:
+            cout << "Analog samples will be saved in RealMark chans at their real times." << endl;
+            break;
+
+         case IRREG_ABORT:
+            cout << "The -irregular=abort option was given, exiting. . ." << endl;
+            exit(1);
+
+         case IRREG_PROMPT:
+         default:
+            cout << "If there are many instances of the rates, the spike2 file " << endl
+                 << "will be large and mostly unusable." << endl
+                 << "If there are just a few, as a side-effect of edits," << endl
+                 << "the spike2 file will be okay." << endl
+                 << "(Use -irregular=resample|realmark|abort to skip this question.)" << endl
+                 << "Do you want to continue (type y for yes, anything else for no): ";
+            getline(cin,choice);
+            if (choice[0] != 'y' && choice[0] != 'Y')
+            {
+               cout << "Exiting. . ." << endl;
+               exit(1);
+            }
+            break;
       }
    }
-   for (auto iter : Intervals)
+   for (auto iter : Intervals.sorted())
       if (iter.second > max_val)
       {
          max_val = iter.second;
          sampIntv = iter.first;
       }
    cout << "Sample interval set to " << sampIntv << " ticks." << endl;
+   if (max_time > MAX_SON32_TIME)
+   {
+      isSon64 = true;
+      cout << "The last time, " << max_time << " ticks, is past the end of a 32-bit .smr file," << endl
+           << "a 64-bit .smrx file will be created." << endl;
+   }
 
+   if (in_file.failed())
+   {
+      cout << "Could not read all of " << inName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
    in_file.close();
    int s2chan = 0;
      // assign chans in edt/bdt/scope chan order
-   for (auto iter = sChans.begin(); iter != sChans.end(); ++iter, ++s2chan)
-      (*iter).second = s2chan;
-   for (auto iter = aChans.begin(); iter != aChans.end(); ++ iter, ++s2chan)
-      (*iter).second = s2chan;
-   cout << "Found " << sChans.size() << " spike chans" << endl;
-   cout << "Found " << aChans.size() << " analog chans" << endl;
+   for (auto& chan : sChans)
+      if (chan != NO_CHAN)
+      {
+         chan = s2chan++;
+         ++numSpike;
+      }
+   for (auto& chan : aChans)
+      if (chan != NO_CHAN)
+      {
+         chan = s2chan++;
+         ++numAnalog;
+      }
+   cout << "Found " << numSpike << " spike chans" << endl;
+   cout << "Found " << numAnalog << " analog chans" << endl;
 }
 
+/* Collect contiguous samples for one wave chan so the lib gets them in
+   blocks instead of one WriteWave call per sample. A sample that is not one
+   sample interval after the last one starts a new block.
+*/
+class WaveBuff
+{
+   public:
+      void add(CSon64File& sFile, TChanNum chan, TAdc val, TSTime64 time)
+      {
+         if (data.capacity() < WAVE_BUFF_SIZ)
+            data.reserve(WAVE_BUFF_SIZ);
+         if (data.size() && time != start + (TSTime64) data.size() * sampIntv)
+            flush(sFile, chan);
+         if (data.empty())
+            start = time;
+         data.push_back(val);
+         if (data.size() == WAVE_BUFF_SIZ)
+            flush(sFile, chan);
+      }
+      void flush(CSon64File& sFile, TChanNum chan)
+      {
+         if (data.empty())
+            return;
+         int res = sFile.WriteWave(chan, data.data(), data.size(), start);
+         if (res < 0)
+            cout << "Wave chan write error: " << res << endl;
+         ++writes;
+         data.clear();
+      }
+      vector<TAdc> data;
+      TSTime64 start = 0;
+      unsigned long writes = 0;
+};
+
+/* Put the samples of one analog chan on a regular grid of sampIntv ticks
+   that starts at the chan's first sample. Samples that are already on the
+   grid are copied as is, the rest are moved onto the grid using linear
+   interpolation or a zero-order hold. Gaps longer than MAX_RESAMP_GAP
+   intervals are not filled.
+*/
+class Resampler
+{
+   public:
+      void add(CSon64File& sFile, TChanNum chan, TAdc val, TSTime64 time)
+      {
+         ++in_samps;
+         if (!have)
+         {
+            have = true;
+            anchor = next = time;
+         }
+         else if (time <= t0)   // duplicate or out of order, nothing to do
+         {
+            ++dropped;
+            return;
+         }
+         else if (time - t0 > MAX_RESAMP_GAP * sampIntv)
+         {
+            ++gaps;
+            next = anchor + ((time - anchor + sampIntv - 1) / sampIntv) * sampIntv;
+         }
+         if ((time - anchor) % sampIntv)
+            ++moved;
+         for ( ; next <= time; next += sampIntv)
+         {
+            TAdc out;
+            if (next == time)
+               out = val;
+            else if (interpLinear)
+               out = lround(v0 + (double)(val - v0) * (next - t0) / (time - t0));
+            else
+               out = v0;
+            buff.add(sFile, chan, out, next);
+            ++out_samps;
+         }
+         t0 = time;
+         v0 = val;
+      }
+      void flush(CSon64File& sFile, TChanNum chan) {buff.flush(sFile, chan);}
+      WaveBuff buff;
+      bool have = false;
+      TSTime64 anchor = 0, next = 0, t0 = 0;
+      TAdc v0 = 0;
+      unsigned long in_samps = 0, out_samps = 0, moved = 0, dropped = 0, gaps = 0;
+};
+
+/* Collect samples for one RealMark chan and write them in batches. Each
+   item is a marker holding one float, the raw ADC value.
+*/
+class MarkBuff
+{
+   public:
+      void add(CSon64File& sFile, TChanNum chan, TAdc val, TSTime64 time)
+      {
+         if (item_size == 0)
+            item_size = sFile.ItemSize(chan);
+         if (items.empty())
+            items.resize(MARK_BUFF_SIZ * item_size);
+         TRealMark* mark = reinterpret_cast<TRealMark*>(&items[count * item_size]);
+         memset(mark, 0, item_size);
+         mark->m_time = time;
+         mark->m_float[0] = val;
+         ++marks;
+         if (++count == MARK_BUFF_SIZ)
+            flush(sFile, chan);
+      }
+      void flush(CSon64File& sFile, TChanNum chan)
+      {
+         if (count == 0)
+            return;
+         int res = sFile.WriteExtMarks(chan, reinterpret_cast<TExtMark*>(items.data()), count);
+         if (res < 0)
+            cout << "RealMark chan write error: " << res << endl;
+         count = 0;
+      }
+      vector<char> items;
+      size_t item_size = 0;
+      size_t count = 0;
+      unsigned long marks = 0;
+};
+
 // Read the edt/bdt file again and save info as if doing
 // a real-time recording.
 void writeFile()
 {
    int res;
    TTimeDate td;
-   int num_s = sChans.size();
-   int num_a = aChans.size();
+   int num_s = numSpike;
+   int num_a = numAnalog;
    TSTime64 time;
    string line;
    //string cpyline;
@@ -266,8 +584,19 @@ void writeFile()
    TAdc a_val;
    char text[200];
    int tot_chans = max((int)MINCHANS, num_s + num_a); // lib requires at least 32 chans
-
-   TSon32File sFile(1); // up to 1 TB file
+   bool irregular = Intervals.size() > 1;
+   bool resample = irregular && irregPolicy == IRREG_RESAMPLE;
+   bool realmark = irregular && irregPolicy == IRREG_REALMARK;
+   vector<WaveBuff> waves(tot_chans);
+   vector<Resampler> resamps(tot_chans);
+   vector<MarkBuff> markers(tot_chans);
+
+   unique_ptr<CSon64File> pFile;
+   if (isSon64)
+      pFile.reset(new TSon64File());
+   else
+      pFile.reset(new TSon32File(1)); // up to 1 TB file
+   CSon64File& sFile = *pFile;
    res = sFile.Create(outName.c_str(),tot_chans);
    if (res != S64_OK)
    {
@@ -326,10 +655,11 @@ void writeFile()
    strm.clear();
 
     // create chans
-   for (auto iter = sChans.begin(); iter != sChans.end(); ++iter)
+   for (ourChan = 0; ourChan < (int) MAX_SPIKE_ID; ++ourChan)
    {
-      ourChan = (*iter).first;
-      chan = (*iter).second;
+      if (sChans[ourChan] == NO_CHAN)
+         continue;
+      chan = sChans[ourChan];
       res = sFile.SetEventChan(chan,100,ceds64::TDataKind::EventRise,ourChan);
       if (res != S64_OK)
          cout << "event chan create res: " << res << endl;
@@ -338,13 +668,23 @@ void writeFile()
       sFile.SetChanTitle(chan,text);
       sFile.SetBuffering(chan,0x4000);
    }
-   for (auto iter = aChans.begin(); iter != aChans.end(); ++ iter, ++chan)
+   for (ourChan = 0; ourChan < (int) MAX_ANALOG_ID; ++ourChan)
    {
-      ourChan = (*iter).first;
-      chan = (*iter).second;
-      res = sFile.SetWaveChan(chan,sampIntv,ceds64::TDataKind::Adc,tickSize,ourChan);
-      if (res != S64_OK)
-         cout << "wave chan create res: " << res << endl;
+      if (aChans[ourChan] == NO_CHAN)
+         continue;
+      chan = aChans[ourChan];
+      if (realmark)
+      {
+         res = sFile.SetExtMarkChan(chan,1.0/(sampIntv*tickSize),ceds64::TDataKind::RealMark,1,1,ourChan);
+         if (res != S64_OK)
+            cout << "RealMark chan create res: " << res << endl;
+      }
+      else
+      {
+         res = sFile.SetWaveChan(chan,sampIntv,ceds64::TDataKind::Adc,tickSize,ourChan);
+         if (res != S64_OK)
+            cout << "wave chan create res: " << res << endl;
+      }
       sFile.SetChanUnits(chan,"");
       sprintf(text,"An %2d",ourChan); // 9 chars or less
       sFile.SetChanTitle(chan,text);
@@ -352,18 +692,18 @@ void writeFile()
       sFile.SetBuffering(chan,0x1000);
    }
 
-   ifstream in_file(inName.c_str());
+   igzstream in_file(inName);
    getline(in_file, line); // skip header
    getline(in_file, line);
 
 // TSTime64 diffs[8] = {0};
 
+   unsigned long lineNum = 2;
    while (getline(in_file,line))
    {
 //      cpyline = line;
-      id = atoi(line.substr(0,5).c_str());
-      time = atoi(line.substr(5).c_str());
-      if (id < 4096 && id != 0)
+      parseLine(line, ++lineNum, id, time);
+      if (id < MAX_SPIKE_ID && id != 0)
       {
          chan = sChans[id];
 //cout << " *** id: " << id << " chan: " << chan << " t: " << time << endl;
@@ -371,7 +711,7 @@ void writeFile()
          if (res != S64_OK)
             cout << "Event chan write error: " << res << endl;
       }
-      else if (id >= 4096)   // an analog channel, id & data are packed
+      else if (id >= MAX_SPIKE_ID)   // an analog channel, id & data are packed
       {
          a_val = id % 4096 - (id % 4096 > 2047) * 4096;
          id /= 4096;
@@ -382,10 +722,47 @@ void writeFile()
 //cout << "t: " << time;
 //time = max(time, time -(time%sampIntv));
 //cout << " newt: " << time << endl;
-         res = sFile.WriteWave(chan,&a_val,1,time);
-         if (res < 0)
-            cout << "Wave chan write error: " << res << endl;
+         if (resample)
+            resamps[chan].add(sFile, chan, a_val, time);
+         else if (realmark)
+            markers[chan].add(sFile, chan, a_val, time);
+         else
+            waves[chan].add(sFile, chan, a_val, time);
+      }
+   }
+   for (chan = 0; chan < tot_chans; ++chan)
+   {
+      waves[chan].flush(sFile, chan);
+      resamps[chan].flush(sFile, chan);
+      markers[chan].flush(sFile, chan);
+   }
+
+   if (resample)
+   {
+      unsigned long in_samps = 0, out_samps = 0, moved = 0, dropped = 0, gaps = 0;
+      for (auto& samp : resamps)
+      {
+         in_samps += samp.in_samps;
+         out_samps += samp.out_samps;
+         moved += samp.moved;
+         dropped += samp.dropped;
+         gaps += samp.gaps;
       }
+      cout << "Resampled analog chans to " << sampIntv << " ticks per sample ("
+           << (interpLinear ? "linear" : "hold") << "):" << endl
+           << "   Samples read:                " << in_samps << endl
+           << "   Samples moved onto the grid: " << moved << endl
+           << "   Samples written:             " << out_samps << endl
+           << "   Duplicate/out of order:      " << dropped << endl
+           << "   Gaps left unfilled:          " << gaps << endl;
+   }
+   else if (realmark)
+   {
+      unsigned long marks = 0;
+      for (auto& mark : markers)
+         marks += mark.marks;
+      cout << "Saved " << marks << " analog samples in " << num_a
+           << " RealMark chans at their recorded times." << endl;
    }
    sFile.Close();
    // need to mod permissions, they are rw------- by default, not what we want
@@ -404,9 +781,10 @@ int main(int argc, char*argv[])
       cout << "Not enough arguments, exiting. . ." << endl;
       exit(1);
    }
-   size_t last = inName.find_last_of(".");
+   string plainName = gz_strip(inName);
+   size_t last = plainName.find_last_of(".");
    if (last != string::npos)
-      baseName = inName.substr(0,last);
+      baseName = plainName.substr(0,last);
    else
    {
       cout << inName << " does not have a .edt or .bdt extension, exiting. . ." << endl;
@@ -417,6 +795,8 @@ int main(int argc, char*argv[])
       outName = baseName + "_from_edt.smr";
    else
       outName = baseName + "_from_bdt.smr";
+   if (isSon64)
+      outName += "x";
    cout << "Creating " << outName << " from " << inName << endl;
    writeFile();
    exit(0);
@@ -12,7 +12,8 @@ win32 {
    DEFINES -= _UNICODE
    QT -= gui
 
-   SOURCES += edt2spike2.cpp
+   SOURCES += edt2spike2.cpp gzstream.cpp
+   HEADERS += gzstream.h
 
    DEFINES += S64_NOTDLL
    CONFIG -= debug
@@ -20,6 +21,7 @@ win32 {
    QMAKE_LFLAGS += -static
    OBJECTS_DIR = mswin
    LIBS += -lson64
+   LIBS += -lz
    LIBS += -lwinpthread
    CONFIG -= debug
    MAKEFILE=Makefile_edt2spike2_win.qt
@@ -0,0 +1,50 @@
+#!/bin/bash
+#
+# Copyright 2005-2020 Kendall F. Morris
+#
+# This file is part of a collection of recording processing software,
+# distributed under the GNU General Public License, version 3 or later.
+# See COPYING.
+#
+# Times edt2spike2 on synthetic files made by edt_synth: a 280 MB edt,
+# and a bdt with irregular analog intervals. Give more than one directory
+# to compare builds, for instance before and after a change to the per
+# line loops. RUNS sets how many times each is run, the best is shown.
+#
+# Usage: edt_bench.sh [dir with edt2spike2 and edt_synth] [more dirs with edt2spike2]
+#
+# Mod History
+# Sun Oct 18 2026 Created.
+
+DIRS=()
+for dir in "${@:-.}"
+do
+   DIRS+=("$(cd "$dir" && pwd)")
+done
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+"${DIRS[0]}/edt_synth" -o bench.edt -lines 20000000 || exit 1
+"${DIRS[0]}/edt_synth" -o bench.bdt -lines 5000000 -irregular || exit 1
+
+echo "Seconds for edt2spike2, best of ${RUNS:-3}, warm cache:"
+TIMEFORMAT=%R
+for file in bench.edt bench.bdt
+do
+   echo "$file $(( $(stat -c %s $file) / 1000000 )) MB"
+   for dir in "${DIRS[@]}"
+   do
+      best=
+      for (( run = 0; run < ${RUNS:-3}; ++run ))
+      do
+         cat $file > /dev/null
+         secs=$( { time "$dir/edt2spike2" -n $file -irregular=resample > /dev/null ; } 2>&1 ) || exit 1
+         if [ -z "$best" ] || awk -v new=$secs -v old=$best 'BEGIN {exit !(new < old)}'
+         then
+            best=$secs
+         fi
+      done
+      echo "   $best  $dir"
+   done
+done
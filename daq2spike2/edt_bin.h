@@ -0,0 +1,74 @@
+#ifndef _EDT_BIN_H
+#define _EDT_BIN_H
+
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Layout of the binary files edt_split --binary writes. Everything is
+   little-endian with no padding, so a file can be mmap'd and used in place.
+
+   <name>_anN.bin, one analog chan:
+      EdtBinHeader, magic "EDTA"
+      int16  sample[count]      12-bit signed values, as edt2spike2 reads them
+      int64  time[count]        only if EDTB_REGULAR is not set, otherwise
+                                sample n is at start + n * interval ticks
+
+   <name>_spk.bin, all the spike firings in file order:
+      EdtBinHeader, magic "EDTS", chan 0, start/interval 0
+      EdtBinSpike record[count]
+
+   Times are in ticks of tickSize seconds, 0.0001 for edt, 0.0005 for bdt.
+*/
+
+#include <cstdint>
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "edt_bin files are written in host byte order, which must be little-endian"
+#endif
+
+const char EDTB_ANALOG_MAGIC[4] = {'E','D','T','A'};
+const char EDTB_SPIKE_MAGIC[4] = {'E','D','T','S'};
+const uint16_t EDTB_VERSION = 1;
+const uint32_t EDTB_REGULAR = 0x1;   // no time array, use start + n * interval
+
+struct EdtBinHeader
+{
+   char magic[4];
+   uint16_t version;
+   uint16_t chan;       // analog chan number, 0 for spikes
+   uint32_t flags;
+   uint32_t recSize;    // bytes per sample or per spike record
+   uint64_t count;      // samples or spike records
+   int64_t start;       // time of the first sample
+   int64_t interval;    // ticks between samples when EDTB_REGULAR is set
+   double tickSize;     // seconds per tick
+};
+
+#pragma pack(push, 1)
+struct EdtBinSpike
+{
+   uint16_t id;
+   int64_t time;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(EdtBinHeader) == 48, "EdtBinHeader must have no padding");
+static_assert(sizeof(EdtBinSpike) == 10, "EdtBinSpike must be packed");
+
+#endif
@@ -0,0 +1,274 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Line input and buffered output for edt/bdt files, see edt_io.h */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+
+#include "edt_io.h"
+
+using namespace std;
+
+
+bool EdtInput::open(const string& name)
+{
+   unsigned char magic[2];
+   struct stat stats;
+
+   close();
+   mapFd = ::open(name.c_str(), O_RDONLY);
+   if (mapFd < 0)
+      return false;
+   if (fstat(mapFd, &stats) == 0 && stats.st_size > 0
+       && pread(mapFd, magic, sizeof(magic), 0) == sizeof(magic)
+       && !(magic[0] == 0x1f && magic[1] == 0x8b))
+   {
+      void* addr = mmap(nullptr, stats.st_size, PROT_READ, MAP_PRIVATE, mapFd, 0);
+      if (addr != MAP_FAILED)
+      {
+         madvise(addr, stats.st_size, MADV_SEQUENTIAL);
+         map = static_cast<char*>(addr);
+         mapSize = stats.st_size;
+         next = map;
+         last = map + mapSize;
+         return true;
+      }
+   }
+     // gzipped, empty, or can't be mapped, read it in chunks
+   ::close(mapFd);
+   mapFd = -1;
+   gz.open(name);
+   if (!gz.is_open())
+      return false;
+   chunk.resize(EDT_IN_CHUNK_SIZ);
+   next = last = chunk.data();
+   return true;
+}
+
+
+void EdtInput::close()
+{
+   if (map)
+      munmap(map, mapSize);
+   if (mapFd >= 0)
+      ::close(mapFd);
+   map = nullptr;
+   mapSize = 0;
+   mapFd = -1;
+   gz.close();
+   chunk.clear();
+   next = last = nullptr;
+}
+
+
+/* Move the partial line at the end of the chunk to the front and read
+   more after it. Return false if nothing more was read.
+*/
+bool EdtInput::fill()
+{
+   if (!gz.is_open() || !gz)
+      return false;
+   size_t left = last - next;
+   size_t off = next - chunk.data();   // resize can move the chunk
+   if (left == chunk.size())   // line longer than the chunk
+      chunk.resize(chunk.size() * 2);
+   memmove(chunk.data(), chunk.data() + off, left);
+   gz.read(chunk.data() + left, chunk.size() - left);
+   size_t got = gz.gcount();
+   next = chunk.data();
+   last = next + left + got;
+   return got > 0;
+}
+
+
+/* Return the next line the way getline does: without the newline, and
+   the last line even if it has no newline.
+*/
+bool EdtInput::line(const char*& begin, const char*& end)
+{
+   const char* nl;
+   size_t searched = 0;
+
+   while (true)
+   {
+      if (next < last && (nl = static_cast<const char*>(memchr(next + searched, '\n', last - next - searched))))
+         break;
+      searched = last - next;
+      if (map || !fill())
+      {
+         if (next == last)
+            return false;
+         begin = next;
+         end = next = last;
+         return true;
+      }
+   }
+   begin = next;
+   end = nl;
+   next = nl + 1;
+   return true;
+}
+
+
+bool EdtWriter::open(const string& fname)
+{
+   close();
+   fileName = fname;
+   fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   written = 0;
+   return fd >= 0;
+}
+
+
+void EdtWriter::close()
+{
+   if (fd < 0)
+      return;
+   flush();
+   if (::close(fd) != 0)
+   {
+      cout << "Error closing " << fileName << ": " << strerror(errno) << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   fd = -1;
+}
+
+
+void EdtWriter::flush()
+{
+   if (buff.size())
+      put(buff.data(), buff.size());
+   buff.clear();
+}
+
+
+void EdtWriter::put(const char* data, size_t len)
+{
+   while (len)
+   {
+      ssize_t res = ::write(fd, data, len);
+      if (res < 0 && errno == EINTR)
+         continue;
+      if (res <= 0)
+      {
+         cout << "Error writing " << fileName << ": " << strerror(errno) << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+      data += res;
+      len -= res;
+      written += res;
+   }
+}
+
+
+void EdtWriter::rewrite(off_t off, const void* data, size_t len)
+{
+   flush();
+   const char* src = static_cast<const char*>(data);
+   while (len)
+   {
+      ssize_t res = pwrite(fd, src, len, off);
+      if (res < 0 && errno == EINTR)
+         continue;
+      if (res <= 0)
+      {
+         cout << "Error writing " << fileName << ": " << strerror(errno) << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+      src += res;
+      len -= res;
+      off += res;
+   }
+}
+
+
+void EdtWriter::copy(int inFd, off_t off, size_t len)
+{
+   flush();
+   while (len)
+   {
+      ssize_t res = copy_file_range(inFd, &off, fd, nullptr, len, 0);
+      if (res < 0 && errno == EINTR)
+         continue;
+      if (res <= 0)
+         break;
+      len -= res;
+      written += res;
+   }
+     // not supported here (old kernel, some file systems), plain reads
+   while (len)
+   {
+      buff.resize(min(len, buff.capacity()));
+      ssize_t res = pread(inFd, buff.data(), buff.size(), off);
+      if (res < 0 && errno == EINTR)
+         continue;
+      if (res <= 0)
+      {
+         cout << "Error reading for " << fileName << ": " << strerror(errno) << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+      put(buff.data(), res);
+      off += res;
+      len -= res;
+   }
+   buff.clear();
+}
+
+
+/* Decode a leading integer the same way atoi does: skip white space,
+   optional sign, digits up to the first non-digit.
+*/
+static int64_t edt_int(const char*& p, const char* end)
+{
+   int64_t val = 0;
+   bool neg = false;
+
+   while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f' || *p == '\n'))
+      ++p;
+   if (p < end && (*p == '-' || *p == '+'))
+      neg = *p++ == '-';
+   while (p < end && *p >= '0' && *p <= '9')
+      val = val * 10 + (*p++ - '0');
+   return neg ? -val : val;
+}
+
+
+unsigned int edt_id(const char* begin, const char* end)
+{
+   if (end - begin > EDT_ID_WIDTH)
+      end = begin + EDT_ID_WIDTH;
+   return static_cast<int>(edt_int(begin, end));
+}
+
+
+int64_t edt_time(const char* begin, const char* end)
+{
+   if (end - begin <= EDT_ID_WIDTH)
+      return 0;
+   begin += EDT_ID_WIDTH;
+   return edt_int(begin, end);
+}
@@ -0,0 +1,124 @@
+#ifndef _EDT_IO_H
+#define _EDT_IO_H
+
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Line input and buffered output for the edt/bdt text tools.
+
+   EdtInput hands out each line of a file as a pointer span into a big
+   buffer, no std::string per line. Plain files are mmap'd, gzipped ones
+   are read through gzstream a few MB at a time.
+
+   EdtWriter collects output in a large buffer and only writes it when it
+   is full or the file is closed. An ofstream with endl flushes on every
+   line, which is one write syscall per line.
+
+   Linux only, like the cygnus tools.
+*/
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "gzstream.h"
+
+const size_t EDT_OUT_BUFF_SIZ = 0x100000;  // 1 MB output buffer per file
+const size_t EDT_IN_CHUNK_SIZ = 0x400000;  // 4 MB of gz text at a time
+const int EDT_ID_WIDTH = 5;                // id field width on each line
+
+class EdtInput
+{
+   public:
+      ~EdtInput() {close();}
+      bool open(const std::string& name);
+      void close();
+        // next line, without the newline, false at end of file
+      bool line(const char*& begin, const char*& end);
+      bool failed() const {return gz.failed();}
+        // the whole file when it is mapped, nullptr for gz files
+      const char* data() const {return map;}
+      size_t size() const {return mapSize;}
+        // offset in a mapped file of the next line
+      size_t pos() const {return next - map;}
+      void seek(size_t off) {next = map + off;}
+      int fd() const {return mapFd;}
+
+   private:
+      bool fill();
+      int mapFd = -1;
+      char* map = nullptr;
+      size_t mapSize = 0;
+      igzstream gz;
+      std::vector<char> chunk;
+      const char* next = nullptr;
+      const char* last = nullptr;
+};
+
+class EdtWriter
+{
+   public:
+      EdtWriter(size_t siz = EDT_OUT_BUFF_SIZ) {buff.reserve(siz);}
+      ~EdtWriter() {close();}
+      EdtWriter(const EdtWriter&) = delete;
+      EdtWriter& operator=(const EdtWriter&) = delete;
+      bool open(const std::string& fname);
+      void close();
+      bool is_open() const {return fd >= 0;}
+      void write(const char* data, size_t len)
+      {
+         if (buff.size() + len > buff.capacity())
+         {
+            flush();
+            if (len > buff.capacity())
+            {
+               put(data, len);
+               return;
+            }
+         }
+         buff.insert(buff.end(), data, data + len);
+      }
+      void line(const char* begin, const char* end)
+      {
+         write(begin, end - begin);
+         write("\n", 1);
+      }
+      void line(const std::string& text) {line(text.data(), text.data() + text.size());}
+      void flush();
+        // append len bytes at off in another file, in the kernel if it can
+      void copy(int inFd, off_t off, size_t len);
+        // write at an offset in the file, such as a header at the start
+      void rewrite(off_t off, const void* data, size_t len);
+      off_t tell() const {return written + buff.size();}
+      const std::string& name() const {return fileName;}
+
+   private:
+      void put(const char* data, size_t len);
+      std::string fileName;
+      std::vector<char> buff;
+      int fd = -1;
+      off_t written = 0;
+};
+
+// The id field as atoi would decode it, and the time that follows it
+unsigned int edt_id(const char* begin, const char* end);
+int64_t edt_time(const char* begin, const char* end);
+
+#endif
@@ -0,0 +1,301 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+/* Merge the _spk and _anN files from edt_split, after they have been
+   filtered or edited, back into one .edt or .bdt file in time order.
+
+   Each input is already in time order, so this is a k-way merge: a heap
+   holds the time of the next line of each input, the earliest is written
+   and that input's next line goes on the heap. Memory use does not depend
+   on the file sizes, the inputs are mmap'd and read once front to back.
+
+   Lines with the same time come out in the order of the input files on the
+   command line. With -f, analog chans are first, in chan order, then the
+   spike file. Which of them came first in the original is not kept by
+   edt_split, so a split and merged file is the same byte for byte only if
+   the original had its same time lines in that order. A recording that
+   has spikes and analog samples mixed in a tick gets the same lines back
+   at the same times, but those in a tick can be in a different order.
+   edt_split drops id 0 lines, so a file that had any will not round trip
+   exactly either.
+
+   Mod History
+   Sun Oct 18 2026 Created.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <iostream>
+#include <getopt.h>
+#include <vector>
+#include <string>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <string.h>
+
+#include "edt_io.h"
+
+using namespace std;
+
+using heapItem = pair<int64_t, size_t>;   // time, input index
+using mergeHeap = priority_queue<heapItem, vector<heapItem>, greater<heapItem>>;
+
+// globals
+string inName;
+string outName;
+string baseName;
+string exten;
+vector<string> inNames;
+
+static void usage()
+{
+   cout << " Program to merge the spike and analog files made by edt_split "
+        << "back into a single .edt or .bdt file in time order."
+        << endl <<"Version " << VERSION << endl
+        << "Usage: edt_merge -f <filename.edt | filename.bdt> [-o <output>]"
+        << endl << "       edt_merge -o <output> <input> <input> . . ."
+        << endl << "For example: "
+        << endl << endl << " edt_merge -f 2014-06-24_001.edt" << endl
+        << endl << "merges 2014-06-24_001_spk.edt and 2014-06-24_001_an*.edt into"
+        << endl << "2014-06-24_001_merged.edt. Lines with the same time are written"
+        << endl << "in input order, with -f that is the analog chans then spikes."
+        << endl << "The merged file matches the original exactly only if its same time"
+        << endl << "lines were in that order, otherwise the lines in a tick may be"
+        << endl << "reordered. Every line is still there, at its time."
+        << endl;
+}
+
+static int parse_args(int argc, char *argv[])
+{
+   int ret = 1;
+   int cmd;
+   static struct option opts[] =
+   {
+      {"f", required_argument, NULL, 'f'},
+      {"o", required_argument, NULL, 'o'},
+      {"h", no_argument, NULL, 'h'},
+      { 0,0,0,0}
+   };
+   while ((cmd = getopt_long_only(argc, argv, "", opts, NULL )) != -1)
+   {
+      switch (cmd)
+      {
+         case 'f':
+               inName = optarg;
+               if (inName.size() == 0)
+               {
+                  cout << "File name is missing." << endl;
+                  ret = 0;
+               }
+               break;
+
+         case 'o':
+               outName = optarg;
+               break;
+
+         case 'h':
+         case '?':
+         default:
+            usage();
+            ret = false;
+           break;
+      }
+   }
+   for (int arg = optind; arg < argc; ++arg)
+      inNames.push_back(argv[arg]);
+   if (ret && inName.empty() && (inNames.empty() || outName.empty()))
+   {
+      cout << "Need -f, or -o and a list of input files." << endl;
+      ret = 0;
+   }
+   if (!ret)
+   {
+      usage();
+      cout << "Exiting. . ." << endl;
+      exit(1);
+   }
+   return ret;
+}
+
+
+/* Find the edt_split outputs for -f name.edt in the current directory.
+   Analog chans are added in chan order, then the spike file.
+*/
+static void findInputs()
+{
+   vector<pair<int, string>> analog;
+   string prefix = baseName + "_an";
+   DIR* dir;
+   struct dirent* entry;
+
+   if (!(dir = opendir(".")))
+   {
+      cout << "Could not read the current directory, exiting. . ." << endl;
+      exit(1);
+   }
+   while ((entry = readdir(dir)))
+   {
+      string name(entry->d_name);
+      if (name.size() <= prefix.size() + exten.size() || name.compare(0, prefix.size(), prefix) != 0
+          || name.compare(name.size() - exten.size(), exten.size(), exten) != 0)
+         continue;
+      string chan = name.substr(prefix.size(), name.size() - prefix.size() - exten.size());
+      if (chan.find_first_not_of("0123456789") == string::npos)
+         analog.push_back(make_pair(stoi(chan), name));
+   }
+   closedir(dir);
+   sort(analog.begin(), analog.end());
+   for (auto& chan : analog)
+      inNames.push_back(chan.second);
+   string s_name = baseName + "_spk" + exten;
+   if (access(s_name.c_str(), R_OK) == 0)
+      inNames.push_back(s_name);
+   if (inNames.empty())
+   {
+      cout << "No " << baseName << "_spk" << exten << " or " << prefix << "N" << exten
+           << " files found, exiting. . ." << endl;
+      exit(1);
+   }
+}
+
+
+/* Open all the inputs, check that they have the same headers, and write
+   them out merged by time.
+   Exit on fatal errors.
+*/
+void mergeFiles()
+{
+   size_t num = inNames.size();
+   vector<unique_ptr<EdtInput>> inputs(num);
+   vector<const char*> lineBegin(num), lineEnd(num);
+   vector<int64_t> lastTime(num);
+   vector<bool> reported(num, false);
+   string header1, header2;
+   mergeHeap heap;
+   const char *begin, *end;
+   struct stat outStats, inStats;
+   bool outExists = stat(outName.c_str(), &outStats) == 0;
+   int64_t lines = 0;
+
+   for (size_t idx = 0; idx < num; ++idx)
+   {
+      if (outExists && stat(inNames[idx].c_str(), &inStats) == 0
+          && inStats.st_dev == outStats.st_dev && inStats.st_ino == outStats.st_ino)
+      {
+         cout << outName << " is also an input, exiting. . ." << endl;
+         exit(1);
+      }
+      inputs[idx].reset(new EdtInput);
+      if (!inputs[idx]->open(inNames[idx]))
+      {
+         cout << "Could not open " << inNames[idx] << endl << "Exiting. . ." << endl;
+         exit(1);
+      }
+      string h1, h2;
+      if (inputs[idx]->line(begin, end))
+         h1.assign(begin, end);
+      if (inputs[idx]->line(begin, end))
+         h2.assign(begin, end);
+      if (h1.find("   11") != 0 && h1.find("   33") != 0)
+      {
+         cout << inNames[idx] << " is not a bdt or edt file, exiting. . ." << endl;
+         exit(1);
+      }
+      if (idx == 0)
+      {
+         header1 = h1;
+         header2 = h2;
+      }
+      else if (h1 != header1 || h2 != header2)
+      {
+         cout << "The header lines of " << inNames[idx] << " do not match " << inNames[0]
+              << ", mixing edt and bdt files? Exiting. . ." << endl;
+         exit(1);
+      }
+      if (inputs[idx]->line(lineBegin[idx], lineEnd[idx]))
+      {
+         lastTime[idx] = edt_time(lineBegin[idx], lineEnd[idx]);
+         heap.push(make_pair(lastTime[idx], idx));
+      }
+   }
+
+   EdtWriter out_file;
+   if (!out_file.open(outName))
+   {
+      cout << "Could not create " << outName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   cout << "Merging " << num << " files into " << outName << endl;
+   out_file.line(header1);
+   out_file.line(header2);
+   while (!heap.empty())
+   {
+      size_t idx = heap.top().second;
+      heap.pop();
+      out_file.line(lineBegin[idx], lineEnd[idx]);
+      ++lines;
+      if (inputs[idx]->line(lineBegin[idx], lineEnd[idx]))
+      {
+         int64_t time = edt_time(lineBegin[idx], lineEnd[idx]);
+         if (time < lastTime[idx] && !reported[idx])
+         {
+            cout << "Warning: " << inNames[idx] << " is not in time order at "
+                 << time << ", the output will not be either." << endl;
+            reported[idx] = true;
+         }
+         lastTime[idx] = time;
+         heap.push(make_pair(time, idx));
+      }
+   }
+   out_file.close();
+   for (size_t idx = 0; idx < num; ++idx)
+      if (inputs[idx]->failed())
+         cout << "Could not read all of " << inNames[idx] << ", " << outName << " is incomplete." << endl;
+   cout << "Wrote " << lines << " lines" << endl;
+}
+
+int main(int argc, char*argv[])
+{
+   parse_args(argc,argv);
+
+   if (inName.size())
+   {
+      string plainName = gz_strip(inName);
+      size_t last = plainName.find_last_of(".");
+      if (last == string::npos)
+      {
+         cout << inName << " does not have a .edt or .bdt extension, exiting. . ." << endl;
+         exit(1);
+      }
+      baseName = plainName.substr(0,last);
+      exten = plainName.substr(last);
+      findInputs();
+      if (outName.empty())
+         outName = baseName + "_merged" + exten;
+   }
+   mergeFiles();
+
+   exit(0);
+}
@@ -0,0 +1,157 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+/* Synthetic edt and bdt files for timing edt2spike2, used by edt_bench.sh.
+
+   The file is an edt if the name ends in .edt, else a bdt. Each tick has
+   the analog samples that are due, random values on -analog chans, one
+   every 50 ticks for an edt and 2 for a bdt, and about one time in three
+   a spike on one of a few spike chans. -irregular makes 5% of the analog
+   intervals a tick longer, so edt2spike2 sees more than one rate.
+   The same arguments always make the same file.
+
+   Mod History
+   Sun Oct 18 2026 Created.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <string>
+#include <iostream>
+#include <vector>
+#include <random>
+
+using namespace std;
+
+const int ANALOG_SHIFT = 4096;   // analog ids are chan * 4096 + 12 bit value
+const int EDT_INTV = 50;
+const int BDT_INTV = 2;
+const int SPIKE_CHANS[] = {3, 7, 12};
+
+// globals
+string OutName;
+long long Lines = 1000000;
+int AnalogChans = 2;
+bool Irregular = false;
+
+static void usage(char* name)
+{
+   printf (
+"\nUsage: %s -o file.edt|file.bdt [-lines n] [-analog n] [-irregular]\n"\
+"\n"\
+"Make a synthetic edt or bdt file of about n lines, default 1000000.\n"\
+"-analog     analog chans, 1 to 15, default 2\n"\
+"-irregular  5%% of the analog intervals are a tick longer\n"\
+"\n"\
+,name);
+}
+
+static bool parse_args(int argc, char *argv[])
+{
+   static struct option opts[] = {
+                                   {"o", required_argument, NULL, 'o'},
+                                   {"lines", required_argument, NULL, 'l'},
+                                   {"analog", required_argument, NULL, 'a'},
+                                   {"irregular", no_argument, NULL, 'i'},
+                                   {"h", no_argument, NULL, 'h'},
+                                   { 0,0,0,0} };
+   int cmd;
+   bool ret = true;
+   opterr = 0;
+
+   while ((cmd = getopt_long_only(argc, argv, "", opts, NULL )) != -1)
+   {
+      switch (cmd)
+      {
+         case 'o':
+               OutName = optarg;
+               break;
+         case 'l':
+               Lines = atoll(optarg);
+               break;
+         case 'a':
+               AnalogChans = atoi(optarg);
+               break;
+         case 'i':
+               Irregular = true;
+               break;
+         case 'h':
+         case '?':
+         default:
+            usage(argv[0]);
+            ret = false;
+            break;
+      }
+   }
+   if (ret && (OutName.empty() || AnalogChans < 1 || AnalogChans > 15 || Lines < 1))
+   {
+      usage(argv[0]);
+      ret = false;
+   }
+   return ret;
+}
+
+int main (int argc, char **argv)
+{
+   if (!parse_args(argc, argv))
+      exit(1);
+
+   bool isEdt = OutName.size() > 4 && OutName.compare(OutName.size() - 4, 4, ".edt") == 0;
+   const char* code = isEdt ? "   33   33\n" : "   11   11\n";
+   int intv = isEdt ? EDT_INTV : BDT_INTV;
+   vector<long long> due(AnalogChans + 1, 0);
+   mt19937 gen(1);
+   uniform_int_distribution<int> value(-2048, 2047);
+   uniform_real_distribution<double> chance(0.0, 1.0);
+   uniform_int_distribution<int> spike(0, sizeof(SPIKE_CHANS) / sizeof(SPIKE_CHANS[0]) - 1);
+   FILE* out = fopen(OutName.c_str(), "w");
+
+   if (!out)
+   {
+      cout << "FATAL ERROR: Could not open " << OutName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   fputs(code, out);
+   fputs(code, out);
+   for (long long tick = 0, left = Lines; left > 0; ++tick)
+   {
+      for (int chan = 1; chan <= AnalogChans; ++chan)
+         if (due[chan] <= tick)
+         {
+            fprintf(out, "%5d%8lld\n", chan * ANALOG_SHIFT + (value(gen) & 0xfff), due[chan]);
+            due[chan] += intv + (Irregular && chance(gen) < 0.05 ? 1 : 0);
+            --left;
+         }
+      if (chance(gen) < 0.3)
+      {
+         fprintf(out, "%5d%8lld\n", SPIKE_CHANS[spike(gen)], tick);
+         --left;
+      }
+   }
+   if (fclose(out) != 0)
+   {
+      cout << "FATAL ERROR: Could not write " << OutName << endl << "Exiting. . ." << endl;
+      exit(1);
+   }
+   return 0;
+}
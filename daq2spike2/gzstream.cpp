@@ -0,0 +1,216 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* Plain or gzip input stream, see gzstream.h */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string.h>
+#include <zlib.h>
+
+#include "gzstream.h"
+
+using namespace std;
+
+const size_t GZ_RAW_SIZ = 0x40000;     // compressed bytes per read
+
+
+bool gzstreambuf::open(const string& name)
+{
+   unsigned char magic[2];
+   struct stat stats;
+
+   close();
+   raw = fopen(name.c_str(), "rb");
+   if (!raw)
+      return false;
+   if (stat(name.c_str(), &stats) == 0)
+      rawSize = stats.st_size;
+   gz = fread(magic, 1, sizeof(magic), raw) == sizeof(magic) && magic[0] == 0x1f && magic[1] == 0x8b;
+   rewind(raw);
+   rawPos = 0;
+   bad = false;
+   done = stop = false;
+   current.resize(GZ_CHUNK_SIZ);
+   setg(current.data(), current.data(), current.data());
+   if (gz)
+   {
+      for (size_t chunk = 0; chunk < GZ_CHUNKS; ++chunk)
+         empty.emplace_back(GZ_CHUNK_SIZ);
+      worker = thread(&gzstreambuf::inflater, this);
+   }
+   return true;
+}
+
+
+void gzstreambuf::close()
+{
+   if (worker.joinable())
+   {
+      {
+         lock_guard<mutex> guard(lock);
+         stop = true;
+      }
+      ready.notify_all();
+      worker.join();
+   }
+   if (raw)
+      fclose(raw);
+   raw = nullptr;
+   full.clear();
+   empty.clear();
+   setg(nullptr, nullptr, nullptr);
+}
+
+
+gzstreambuf::int_type gzstreambuf::underflow()
+{
+   if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+   if (!raw)
+      return traits_type::eof();
+
+   if (!gz)
+   {
+      size_t got = fread(current.data(), 1, current.size(), raw);
+      rawPos += got;
+      if (got == 0)
+         return traits_type::eof();
+      setg(current.data(), current.data(), current.data() + got);
+      return traits_type::to_int_type(*gptr());
+   }
+
+     // give the used buffer back to the inflater and wait for the next one
+   unique_lock<mutex> guard(lock);
+   if (current.capacity())
+   {
+      current.resize(GZ_CHUNK_SIZ);
+      empty.push_back(move(current));
+      ready.notify_all();
+   }
+   ready.wait(guard, [this]{return !full.empty() || done;});
+   if (full.empty())
+   {
+      current.clear();
+      current.shrink_to_fit();
+      setg(nullptr, nullptr, nullptr);
+      return traits_type::eof();
+   }
+   current = move(full.front());
+   full.pop_front();
+   setg(current.data(), current.data(), current.data() + current.size());
+   return traits_type::to_int_type(*gptr());
+}
+
+
+/* Decompression thread. Fill empty buffers with inflated data and queue
+   them for the reader. A corrupt or truncated file ends the stream early
+   and sets the failed flag.
+*/
+void gzstreambuf::inflater()
+{
+   z_stream strm;
+   vector<unsigned char> in(GZ_RAW_SIZ);
+   vector<char> out;
+   int res = Z_OK;
+   bool at_eof = false;
+
+   memset(&strm, 0, sizeof(strm));
+   if (inflateInit2(&strm, 15 + 32) != Z_OK)  // 32: expect a gzip header
+   {
+      cerr << "Could not start zlib" << endl;
+      bad = true;
+   }
+   while (!bad)
+   {
+      {
+         unique_lock<mutex> guard(lock);
+         ready.wait(guard, [this]{return !empty.empty() || stop;});
+         if (stop)
+            break;
+         out = move(empty.front());
+         empty.pop_front();
+      }
+      out.resize(GZ_CHUNK_SIZ);
+      strm.next_out = reinterpret_cast<Bytef*>(out.data());
+      strm.avail_out = out.size();
+      while (strm.avail_out)
+      {
+         if (strm.avail_in == 0)
+         {
+            size_t got = fread(in.data(), 1, in.size(), raw);
+            rawPos += got;
+            if (got == 0)
+            {
+               at_eof = true;
+               if (res != Z_STREAM_END)
+               {
+                  cerr << "Compressed file is truncated" << endl;
+                  bad = true;
+               }
+               break;
+            }
+            strm.next_in = in.data();
+            strm.avail_in = got;
+         }
+         if (res == Z_STREAM_END)   // another gzip member follows
+            inflateReset(&strm);
+         res = inflate(&strm, Z_NO_FLUSH);
+         if (res != Z_OK && res != Z_STREAM_END)
+         {
+            cerr << "Error decompressing file: " << (strm.msg ? strm.msg : "unknown") << endl;
+            bad = true;
+            break;
+         }
+      }
+      out.resize(GZ_CHUNK_SIZ - strm.avail_out);
+      {
+         lock_guard<mutex> guard(lock);
+         if (out.size())
+            full.push_back(move(out));
+         if (at_eof || bad)
+            done = true;
+      }
+      ready.notify_all();
+      if (at_eof)
+         break;
+   }
+   inflateEnd(&strm);
+   lock_guard<mutex> guard(lock);
+   done = true;
+   ready.notify_all();
+}
+
+
+string gz_name(const string& name)
+{
+   struct stat stats;
+   if (stat(name.c_str(), &stats) != 0 && stat((name + ".gz").c_str(), &stats) == 0)
+      return name + ".gz";
+   return name;
+}
+
+
+string gz_strip(const string& name)
+{
+   if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0)
+      return name.substr(0, name.size() - 3);
+   return name;
+}
@@ -0,0 +1,107 @@
+#ifndef _GZSTREAM_H
+#define _GZSTREAM_H
+
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* An input stream that reads plain or gzip compressed files. The archive
+   keeps edt/bdt text and older .daq files gzipped, this lets the converters
+   read them without decompressing to scratch disk first.
+
+   Compressed files are detected by the gzip magic bytes, not the name.
+   Decompression runs on its own thread and hands full buffers to the reader,
+   so inflating overlaps with parsing. Concatenated gzip members (gzip -c a b,
+   pigz) are read as one stream. Seeking is not supported, open the file
+   again to make another pass.
+*/
+
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+const size_t GZ_CHUNK_SIZ = 0x100000;  // 1 MB of decompressed data per buffer
+const size_t GZ_CHUNKS = 4;            // buffers in flight between threads
+
+class gzstreambuf : public std::streambuf
+{
+   public:
+      gzstreambuf() {}
+      ~gzstreambuf() {close();}
+      bool open(const std::string& name);
+      void close();
+      bool is_open() const {return raw != nullptr;}
+      bool compressed() const {return gz;}
+      bool failed() const {return bad;}
+      int64_t raw_pos() const {return rawPos;}
+      int64_t raw_size() const {return rawSize;}
+
+   protected:
+      int_type underflow() override;
+
+   private:
+      void inflater();
+      FILE* raw = nullptr;
+      bool gz = false;
+      std::atomic<bool> bad{false};
+      std::atomic<int64_t> rawPos{0};
+      int64_t rawSize = 0;
+      std::vector<char> current;
+      std::thread worker;
+      std::mutex lock;
+      std::condition_variable ready;
+      std::deque<std::vector<char>> full;
+      std::deque<std::vector<char>> empty;
+      bool done = false;
+      bool stop = false;
+};
+
+class igzstream : public std::istream
+{
+   public:
+      igzstream() : std::istream(&buf) {}
+      explicit igzstream(const std::string& name) : std::istream(&buf) {open(name);}
+      void open(const std::string& name) {if (!buf.open(name)) setstate(std::ios::failbit);}
+      void close() {buf.close();}
+      bool is_open() const {return buf.is_open();}
+      bool compressed() const {return buf.compressed();}
+      bool failed() const {return buf.failed();}
+        // bytes of the file on disk used so far, and the file size, for
+        // progress reports
+      int64_t raw_pos() const {return buf.raw_pos();}
+      int64_t raw_size() const {return buf.raw_size();}
+
+   private:
+      gzstreambuf buf;
+};
+
+// If name does not exist but name.gz does, return name.gz
+std::string gz_name(const std::string& name);
+
+// Remove a trailing .gz, if any
+std::string gz_strip(const std::string& name);
+
+#endif
@@ -0,0 +1,336 @@
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+
+/* Checks PulseScanner against the timing pulse searches it replaced, run
+   by make check. Built twice, pulse_check with the SSE2 skip and
+   pulse_check_scalar without it.
+
+   ref_after_fall() is the search sync_timings() did in cyg2daq and
+   ref_at_fall() the one next_pulse() did in cyg2cyg25KHz, logic for logic,
+   on a buffer instead of a stream. Random signals of a few kinds, noise
+   near zero, slow ramps with drops, and pulse like runs, are fed to the
+   scanner in random size pieces:
+
+      cyg2daq       the first pulse, the fall block, from a few places
+      cyg2cyg25KHz  every pulse, the top block, searched again from each
+                    peak the way next_pulse() was called
+
+   The old next_pulse() could not go on from a pulse whose 10th rise was
+   its peak, it left PeakBlock at 0. Up to there it must agree, and the
+   scanner must give the run start as top. That case is also checked on
+   its own.
+
+   Mod History
+   Sun Oct 18 2026 Created.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "cyg_pulse.h"
+
+using namespace std;
+
+const off_t BASE = TAPE_SECTOR_SIZ / PULSE_BLOCK_SIZ;   // first data block
+const int BLOCK_SHORTS = PULSE_BLOCK_SIZ / sizeof(short);
+const int SIGNALS = 3000;
+const off_t NOT_FOUND = -1;
+
+// globals
+vector<short> Blocks;   // the signal, BLOCK_SHORTS a block from BASE on
+off_t Count;
+int Word;
+mt19937 Rng(12345);
+
+static short sample(off_t blk)
+{
+   return Blocks[(blk - BASE) * BLOCK_SHORTS + Word];
+}
+
+// sync_timings() in cyg2daq, returns the first block after the peak that is lower
+static off_t ref_after_fall(off_t from)
+{
+   bool find_peak = false;
+   off_t curr_start = 0;
+   int seq_pos = 0;
+   short max_sample = 0;
+
+   for (off_t blk = from; blk < BASE + Count; )
+   {
+      off_t at = blk;
+      short val = sample(blk++);
+      if (find_peak)
+      {
+         if (max_sample < val)
+            max_sample = val;
+         else if (max_sample > val)
+            return at;
+      }
+      else if (val <= 0)
+         curr_start = seq_pos = 0;
+      else if (curr_start == 0)
+      {
+         curr_start = at;
+         seq_pos = 0;
+         max_sample = val;
+      }
+      else if (val > max_sample)
+      {
+         max_sample = val;
+         if (++seq_pos == PULSE_MIN_RISE)   // back to the start of the pulse
+         {
+            find_peak = true;
+            blk = curr_start;
+            max_sample = 0;
+         }
+      }
+      else if (val < max_sample)
+      {
+         curr_start = 0;
+         max_sample = 0;
+         seq_pos = 0;
+      }
+   }
+   return NOT_FOUND;
+}
+
+/* next_pulse() in cyg2cyg25KHz, returns the peak block. stuck is set if
+   the peak was the 10th rise, where the old code had no PeakBlock.
+*/
+static off_t ref_at_fall(off_t from, bool& stuck)
+{
+   bool find_peak = false;
+   bool in_peak = false;
+   unsigned short max_sample = 0;
+   int mono_pos = 0;
+   off_t peak = 0;
+
+   for (off_t blk = from; blk < BASE + Count; ++blk)
+   {
+      short val = sample(blk);
+      if (find_peak)
+      {
+         if (max_sample < val)
+         {
+            max_sample = val;
+            peak = blk;
+            in_peak = true;
+         }
+         else if (max_sample > val)
+         {
+            stuck = !in_peak;
+            return peak;
+         }
+      }
+      else if (val <= 0)
+         peak = mono_pos = 0;
+      else if (peak == 0)
+      {
+         peak = blk;
+         mono_pos = 0;
+         max_sample = val;
+      }
+      else if (val > max_sample)
+      {
+         max_sample = val;
+         if (++mono_pos == PULSE_MIN_RISE)
+            find_peak = true;
+      }
+      else if (val < max_sample)
+      {
+         max_sample = val;
+         peak = blk;
+         mono_pos = 0;
+      }
+   }
+   return NOT_FOUND;
+}
+
+// Feed the scanner from block from on in pieces of up to chunk blocks
+static void scan_pieces(PulseScanner& scanner, off_t from, size_t chunk, PulseList& hits, size_t want)
+{
+   for (off_t at = from; at < BASE + Count && hits.size() < want; )
+   {
+      size_t count = min(static_cast<off_t>(chunk), BASE + Count - at);
+      at += scanner.scan(reinterpret_cast<const char*>(&Blocks[(at - BASE) * BLOCK_SHORTS]), count, at, hits, want);
+   }
+}
+
+static void make_signal()
+{
+   Count = 50 + Rng() % 20000;
+   Word = Rng() % BLOCK_SHORTS;
+   Blocks.resize(Count * BLOCK_SHORTS);
+   for (auto& val : Blocks)
+      val = Rng();
+   int kind = Rng() % 3;
+   short val = 0;
+   for (off_t blk = 0; blk < Count; ++blk)
+   {
+      int pct = Rng() % 100;
+      if (kind == 0)        // noise near zero
+      {
+         val += static_cast<int>(Rng() % 7) - 2;
+         if (val > 40 || val < -10)
+            val = -5;
+      }
+      else if (kind == 1)   // slow ramps that drop back
+      {
+         if (pct < 3)
+            val = -static_cast<int>(Rng() % 10);
+         else
+            val += static_cast<int>(Rng() % 5) - 1;
+         if (val > 300)
+            val = 0;
+      }
+      else                  // pulse like runs with dips
+      {
+         if (pct < 1)
+            val = 1;
+         else if (val > 0)
+            val += pct < 70 ? static_cast<int>(Rng() % 50) : -static_cast<int>(Rng() % 30);
+         else
+            val = -static_cast<int>(Rng() % 3);
+         if (val > 30000)
+            val = -3;
+      }
+      Blocks[blk * BLOCK_SHORTS + Word] = val;
+   }
+}
+
+static bool check_after_fall(int signal)
+{
+   for (int tries = 0; tries < 3; ++tries)
+   {
+      off_t from = BASE + (tries ? Rng() % Count : 0);
+      PulseScanner scanner(Word, RESTART_AFTER_FALL);
+      PulseList hits;
+      scan_pieces(scanner, from, 1 + Rng() % 700, hits, 1);
+      off_t mine = hits.empty() ? NOT_FOUND : hits[0].fall;
+      off_t ref = ref_after_fall(from);
+      if (mine != ref)
+      {
+         printf("cyg2daq rule, signal %d from block %lld: scanner %lld, old search %lld\n",
+                signal, static_cast<long long>(from), static_cast<long long>(mine), static_cast<long long>(ref));
+         return false;
+      }
+   }
+   return true;
+}
+
+/* next_pulse() was first called at the start, then from each peak for
+   the first two, then from the block before it.
+*/
+static bool check_at_fall(int signal, long& pulses, long& stuck)
+{
+   PulseScanner scanner(Word, RESTART_AT_FALL);
+   PulseList hits;
+   off_t from = BASE;
+
+   scan_pieces(scanner, BASE, 1 + Rng() % 700, hits, static_cast<size_t>(-1));
+   for (size_t idx = 0; ; ++idx)
+   {
+      bool top_is_start = false;
+      off_t ref = ref_at_fall(from, top_is_start);
+      off_t mine = idx < hits.size() ? hits[idx].top : NOT_FOUND;
+      if (mine != ref)
+      {
+         printf("cyg2cyg25KHz rule, signal %d pulse %zu: scanner %lld, old search %lld\n",
+                signal, idx, static_cast<long long>(mine), static_cast<long long>(ref));
+         return false;
+      }
+      if (ref == NOT_FOUND)
+         return true;
+      ++pulses;
+      if (top_is_start)
+      {
+         ++stuck;
+         return true;
+      }
+      from = max(idx < 2 ? ref : ref - 1, BASE);
+   }
+}
+
+/* A pulse that peaks on its 10th rise, from a run that starts at block
+   BASE + 5. top must be the run start.
+*/
+static bool check_tenth_rise()
+{
+   Count = 100;
+   Word = 15;
+   Blocks.assign(Count * BLOCK_SHORTS, 0);
+   for (off_t blk = 0; blk < Count; ++blk)
+      Blocks[blk * BLOCK_SHORTS + Word] = -5;
+   for (int rise = 0; rise <= PULSE_MIN_RISE; ++rise)
+      Blocks[(5 + rise) * BLOCK_SHORTS + Word] = 100 * (rise + 1);
+   Blocks[(6 + PULSE_MIN_RISE) * BLOCK_SHORTS + Word] = 50;
+
+   for (PULSE_RULE rule : {RESTART_AFTER_FALL, RESTART_AT_FALL})
+   {
+      PulseScanner scanner(Word, rule);
+      PulseList hits;
+      scan_pieces(scanner, BASE, 3, hits, static_cast<size_t>(-1));
+      if (hits.size() != 1 || hits[0].top != BASE + 5 || hits[0].fall != BASE + 6 + PULSE_MIN_RISE)
+      {
+         printf("Peak on the 10th rise, rule %d: %zu pulses, top %lld, fall %lld\n", rule, hits.size(),
+                hits.empty() ? -1LL : static_cast<long long>(hits[0].top),
+                hits.empty() ? -1LL : static_cast<long long>(hits[0].fall));
+         return false;
+      }
+   }
+   bool stuck = false;
+   if (ref_at_fall(BASE, stuck) != BASE + 5 || !stuck || ref_after_fall(BASE) != BASE + 6 + PULSE_MIN_RISE)
+   {
+      printf("The old searches do not see the 10th rise pulse as expected\n");
+      return false;
+   }
+   return true;
+}
+
+int main ()
+{
+   long pulses = 0, stuck = 0;
+
+#if defined(__SSE2__)
+   printf("PulseScanner with the SSE2 skip\n");
+#else
+   printf("PulseScanner, scalar only\n");
+#endif
+   for (int signal = 0; signal < SIGNALS; ++signal)
+   {
+      make_signal();
+      if (!check_after_fall(signal) || !check_at_fall(signal, pulses, stuck))
+         exit(1);
+   }
+   if (!pulses || !stuck)
+   {
+      printf("The signals did not have enough pulses to check, %ld, %ld on the 10th rise\n", pulses, stuck);
+      exit(1);
+   }
+   if (!check_tenth_rise())
+      exit(1);
+   printf("ok: %d signals, %ld pulses, %ld peaked on the 10th rise\n", SIGNALS, pulses, stuck);
+   return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef _SPSC_RING_H
+#define _SPSC_RING_H
+
+/*
+Copyright 2005-2020 Kendall F. Morris
+
+This file is part of a collection of recording processing software.
+
+    The is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    The suite is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with the suite.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/* A fixed size ring of N slots between one producer thread and one
+   consumer thread, with no locks. The producer fills the slot claim()
+   returns and then calls publish(). The consumer uses the slot front()
+   returns and then calls pop(). Slots are reused in place, nothing is
+   copied or allocated once the ring exists.
+
+   The _wait versions spin for a while, then yield, then sleep briefly, so
+   a waiting thread does not hog a core the other one needs.
+*/
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscRing
+{
+   public:
+        // producer side
+      T* claim()
+      {
+         size_t at = head.load(std::memory_order_relaxed);
+         if (at - tail.load(std::memory_order_acquire) == N)
+            return nullptr;
+         return &slots[at % N];
+      }
+      T* claim_wait()
+      {
+         T* slot;
+         for (unsigned tries = 0; !(slot = claim()); ++tries)
+            pause(tries);
+         return slot;
+      }
+      void publish() {head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);}
+
+        // consumer side
+      T* front()
+      {
+         size_t at = tail.load(std::memory_order_relaxed);
+         if (at == head.load(std::memory_order_acquire))
+            return nullptr;
+         return &slots[at % N];
+      }
+      T* front_wait()
+      {
+         T* slot;
+         for (unsigned tries = 0; !(slot = front()); ++tries)
+            pause(tries);
+         return slot;
+      }
+      void pop() {tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);}
+
+   private:
+      static void pause(unsigned tries)
+      {
+         if (tries < 64)
+            return;
+         else if (tries < 256)
+            std::this_thread::yield();
+         else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+      std::array<T,N> slots;
+      alignas(64) std::atomic<size_t> head{0};   // next slot to fill
+      alignas(64) std::atomic<size_t> tail{0};   // next slot to use
+};
+
+#endif